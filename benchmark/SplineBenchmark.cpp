@@ -0,0 +1,146 @@
+// Throughput benchmarks for BSplineCurveFitterWindow3 on synthetic skeletons.
+//
+//   SplineBenchmark --benchmark_counters_tabular=true
+//
+// Every benchmark takes (branch kind, number of branches) and reports
+// branches/s, samples/s and the memory of that run: the peak scratch memory
+// of the fitter's arenas (scratch_peak_B) and the size of what the measured
+// call produces (output_B). Both are per run, so they do not depend on the
+// benchmarks that ran before.
+
+#include "BSplineCurveFitterWindow3.h"
+#include "SyntheticSkeleton.h"
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    float const Hausdorff = 0.003f;
+    unsigned int const Seed = 20201;
+
+    // Generated outside the timed loop and freed with the run, so only the
+    // input being measured is resident.
+    SyntheticSkeleton Skeleton(benchmark::State const& state)
+    {
+        return MakeSyntheticSkeleton((BranchKind)state.range(0), (int)state.range(1), Seed);
+    }
+
+    size_t SampleBytes(vector<vector<Vector3<float>>> const& layers)
+    {
+        size_t numSamples = 0;
+        for (auto const& layer : layers) numSamples += layer.size();
+        return numSamples * sizeof(Vector3<float>);
+    }
+
+    size_t IndexBytes(vector<vector<vector<Vector3<float>>>> const& index)
+    {
+        size_t bytes = 0;
+        for (auto const& layer : index) bytes += SampleBytes(layer);
+        return bytes;
+    }
+
+    void Report(benchmark::State& state, SyntheticSkeleton const& skeleton,
+        BSplineCurveFitterWindow3 const& fitter, size_t outputBytes)
+    {
+        state.counters["branches/s"] = benchmark::Counter((double)skeleton.branches.size(),
+            benchmark::Counter::kIsIterationInvariantRate);
+        state.counters["samples/s"] = benchmark::Counter((double)skeleton.NumSamples(),
+            benchmark::Counter::kIsIterationInvariantRate);
+        state.counters["scratch_peak_B"] = (double)fitter.get_arenaStats().peakBytes;
+        state.counters["output_B"] = (double)outputBytes;
+    }
+
+    void Inputs(benchmark::internal::Benchmark* bench)
+    {
+        for (int kind : {(int)BranchKind::Straight, (int)BranchKind::Noisy, (int)BranchKind::Spiral,
+            (int)BranchKind::Long, (int)BranchKind::Mixed})
+            for (int numBranches : {16, 64, 256})
+                bench->Args({kind, numBranches});
+        bench->ArgNames({"kind", "branches"})->Unit(benchmark::kMillisecond);
+    }
+}
+
+static void BM_SplineFit(benchmark::State& state)
+{
+    SyntheticSkeleton skeleton = Skeleton(state);
+    vector<int *> connection = skeleton.Connection();
+    BSplineCurveFitterWindow3 fitter;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(fitter.SplineFit(skeleton.branches, Hausdorff, skeleton.diagonal, 0, connection));
+    // SplineFit only counts control points.
+    Report(state, skeleton, fitter, 0);
+}
+BENCHMARK(BM_SplineFit)->Apply(Inputs);
+
+template <bool mergeOrNot, bool saliency>
+static void BM_SplineFit2(benchmark::State& state)
+{
+    SyntheticSkeleton skeleton = Skeleton(state);
+    vector<int *> connection = skeleton.Connection();
+    float* smd = saliency ? skeleton.saliency.data() : nullptr;
+    BSplineCurveFitterWindow3 fitter;
+    int numTriples = 0;
+    for (auto _ : state)
+    {
+        fitter.clear_IndexingCP_Interactive();
+        numTriples = fitter.SplineFit2(skeleton.branches, Hausdorff, skeleton.diagonal,
+            skeleton.width, connection, mergeOrNot, smd);
+        benchmark::DoNotOptimize(numTriples);
+    }
+    Report(state, skeleton, fitter, numTriples * sizeof(Vector3<float>));
+}
+BENCHMARK_TEMPLATE(BM_SplineFit2, false, false)->Apply(Inputs);
+BENCHMARK_TEMPLATE(BM_SplineFit2, true, false)->Apply(Inputs);
+BENCHMARK_TEMPLATE(BM_SplineFit2, false, true)->Apply(Inputs);
+BENCHMARK_TEMPLATE(BM_SplineFit2, true, true)->Apply(Inputs);
+
+static void BM_indexingSpline(benchmark::State& state)
+{
+    SyntheticSkeleton skeleton = Skeleton(state);
+    BSplineCurveFitterWindow3 fitter;
+    for (auto _ : state)
+    {
+        fitter.clear_IndexingCP();
+        fitter.indexingSpline(skeleton.branches, Hausdorff, skeleton.diagonal, 0, 0);
+    }
+    Report(state, skeleton, fitter, IndexBytes(fitter.get_indexingCP()));
+}
+BENCHMARK(BM_indexingSpline)->Apply(Inputs);
+
+static void BM_ReadIndexingSpline(benchmark::State& state)
+{
+    SyntheticSkeleton skeleton = Skeleton(state);
+    BSplineCurveFitterWindow3 fitter;
+    fitter.indexingSpline(skeleton.branches, Hausdorff, skeleton.diagonal, 0, 0);
+    size_t outputBytes = 0;
+    for (auto _ : state)
+    {
+        vector<vector<Vector3<float>>> samples = fitter.ReadIndexingSpline();
+        outputBytes = SampleBytes(samples);
+        benchmark::DoNotOptimize(samples);
+    }
+    Report(state, skeleton, fitter, outputBytes);
+}
+BENCHMARK(BM_ReadIndexingSpline)->Apply(Inputs);
+
+static void BM_SplineGenerate(benchmark::State& state)
+{
+    SyntheticSkeleton skeleton = Skeleton(state);
+    vector<int *> connection = skeleton.Connection();
+    BSplineCurveFitterWindow3 fitter;
+    fitter.SplineFit2(skeleton.branches, Hausdorff, skeleton.diagonal, skeleton.width, connection, false, nullptr);
+    size_t outputBytes = 0;
+    for (auto _ : state)
+    {
+        // Decode every layer, not SplineGenerate()'s cached samples.
+        state.PauseTiming();
+        fitter.clear_generatedSamples();
+        state.ResumeTiming();
+        vector<vector<Vector3<float>>> samples = fitter.SplineGenerate();
+        outputBytes = SampleBytes(samples);
+        benchmark::DoNotOptimize(samples);
+    }
+    Report(state, skeleton, fitter, outputBytes);
+}
+BENCHMARK(BM_SplineGenerate)->Apply(Inputs);
+
+BENCHMARK_MAIN();
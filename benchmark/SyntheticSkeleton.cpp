@@ -0,0 +1,144 @@
+#include "SyntheticSkeleton.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    class Random
+    {
+    public:
+        explicit Random(unsigned int seed) : mState(0x9e3779b97f4a7c15ull ^ seed) { Next(); }
+
+        unsigned long long Next()
+        {
+            mState ^= mState << 13;
+            mState ^= mState >> 7;
+            mState ^= mState << 17;
+            return mState;
+        }
+
+        // Uniform in [0, 1).
+        float Unit() { return (float)((Next() >> 40) * (1.0 / 16777216.0)); }
+        float Range(float a, float b) { return a + (b - a) * Unit(); }
+
+    private:
+        unsigned long long mState;
+    };
+
+    // Rasterize a parametric curve into an 8-connected chain of distinct pixels.
+    template <typename Curve>
+    vector<Vector3<float>> Trace(Curve const& curve, int numSteps, SyntheticSkeleton const& skeleton)
+    {
+        vector<Vector3<float>> branch;
+        int lastX = -1, lastY = -1;
+        for (int i = 0; i <= numSteps; ++i)
+        {
+            float x, y, radius;
+            curve((float)i / (float)numSteps, x, y, radius);
+            int px = (int)x, py = (int)y;
+            if (px < 0 || py < 0 || px >= skeleton.width || py >= skeleton.height) break;
+            if (px == lastX && py == lastY) continue;
+            lastX = px; lastY = py;
+            Vector3<float> sample;
+            sample[0] = px / skeleton.diagonal;
+            sample[1] = py / skeleton.diagonal;
+            sample[2] = std::floor(radius) / skeleton.diagonal;
+            branch.push_back(sample);
+        }
+        return branch;
+    }
+}
+
+vector<int *> SyntheticSkeleton::Connection()
+{
+    vector<int *> connection;
+    for (auto& entry : junctions) connection.push_back(entry.data());
+    return connection;
+}
+
+size_t SyntheticSkeleton::NumSamples() const
+{
+    size_t numSamples = 0;
+    for (auto const& branch : branches) numSamples += branch.size();
+    return numSamples;
+}
+
+SyntheticSkeleton MakeSyntheticSkeleton(BranchKind kind, int numBranches, unsigned int seed, int width, int height)
+{
+    SyntheticSkeleton skeleton;
+    skeleton.width = width;
+    skeleton.height = height;
+    skeleton.diagonal = std::sqrt((float)(width * width + height * height));
+    Random random(seed);
+
+    float const pi = 3.14159265f;
+    // Branch 0 is never cut: a neighbour index of 0 means "none" in the table.
+    while ((int)skeleton.branches.size() < numBranches)
+    {
+        BranchKind branchKind = kind;
+        if (kind == BranchKind::Mixed) branchKind = (BranchKind)(random.Next() % 4);
+
+        float cx = random.Range(0.2f, 0.8f) * width, cy = random.Range(0.2f, 0.8f) * height;
+        float angle = random.Range(0.0f, 2 * pi);
+        float baseRadius = random.Range(2.0f, 12.0f);
+        float length, bend = 0.0f, noise = 0.0f, phase = random.Range(0.0f, 2 * pi);
+        switch (branchKind)
+        {
+        case BranchKind::Straight: length = random.Range(20.0f, 120.0f); break;
+        case BranchKind::Noisy: length = random.Range(30.0f, 150.0f); noise = random.Range(1.0f, 3.0f); break;
+        case BranchKind::Spiral: length = random.Range(150.0f, 400.0f); bend = random.Range(3.0f, 6.0f) * pi; break;
+        default: length = random.Range(600.0f, 1500.0f); bend = random.Range(0.5f, 2.0f) * pi; break;
+        }
+
+        // Frozen noise so that the curve is a function of t only.
+        float noiseFrequency = random.Range(10.0f, 30.0f);
+        auto curve = [&](float t, float& x, float& y, float& radius)
+        {
+            float theta = angle + bend * t;
+            float s = length * t;
+            if (branchKind == BranchKind::Spiral)
+            {
+                float r = 10.0f + 0.15f * s;
+                x = cx + r * std::cos(theta);
+                y = cy + r * std::sin(theta);
+            }
+            else
+            {
+                // Integrate a heading that turns linearly with arc length.
+                float heading = angle + 0.5f * bend * t;
+                x = cx + s * std::cos(heading) - 0.5f * length * std::cos(angle);
+                y = cy + s * std::sin(heading) - 0.5f * length * std::sin(angle);
+            }
+            x += noise * std::sin(noiseFrequency * 2 * pi * t + phase);
+            y += noise * std::cos(1.3f * noiseFrequency * 2 * pi * t + phase);
+            radius = baseRadius * (1.0f + 0.3f * std::sin(2 * pi * t + phase));
+        };
+        vector<Vector3<float>> branch = Trace(curve, (int)(length * 2), skeleton);
+        if (branch.size() < 4) continue;
+
+        int numPieces = 1;
+        if (!skeleton.branches.empty() && branch.size() >= 24 && random.Next() % 3 == 0)
+            numPieces = 2 + (int)(random.Next() % 2);
+        numPieces = std::min(numPieces, numBranches - (int)skeleton.branches.size());
+        size_t pieceSize = branch.size() / numPieces;
+        int first = (int)skeleton.branches.size();
+        for (int p = 0; p < numPieces; ++p)
+        {
+            auto begin = branch.begin() + p * pieceSize;
+            auto end = (p + 1 == numPieces) ? branch.end() : begin + pieceSize;
+            skeleton.branches.emplace_back(begin, end);
+        }
+        for (int p = 0; p + 1 < numPieces; ++p)
+        {
+            array<int, 4> entry = {first + p, first + p + 1, 0, 0};
+            skeleton.junctions.push_back(entry);
+        }
+    }
+
+    skeleton.saliency.resize((size_t)width * height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            skeleton.saliency[(size_t)y * width + x] =
+                std::floor(127.5f + 127.5f * std::sin(x * 0.01f) * std::cos(y * 0.013f));
+    return skeleton;
+}
@@ -0,0 +1,38 @@
+// Deterministic synthetic skeletons for benchmarking the fitter.
+//
+// Branches are 8-connected pixel chains normalized by the image diagonal, with
+// the third coordinate holding a slowly varying radius, like the branches the
+// skeletonizer hands to BSplineCurveFitterWindow3. A fixed xorshift generator
+// is used instead of <random> distributions so that a given seed yields the
+// same skeleton with every standard library.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include <array>
+#include <vector>
+using namespace gte;
+using namespace std;
+
+enum class BranchKind { Straight, Noisy, Spiral, Long, Mixed };
+
+struct SyntheticSkeleton
+{
+    int width = 0, height = 0;
+    float diagonal = 0.0f;
+    vector<vector<Vector3<float>>> branches;
+    // Junction table: entry[0] is a branch, entry[1..3] are the branches that
+    // continue it (0 for none), the layout Merge() expects.
+    vector<array<int, 4>> junctions;
+    // width*height saliency map with values in [0,255].
+    vector<float> saliency;
+
+    // Raw entry pointers for SplineFit/SplineFit2; valid while this object is.
+    vector<int *> Connection();
+    size_t NumSamples() const;
+};
+
+// 'numBranches' branches of the given kind on a width x height image. About a
+// third of the curves are cut into two or three pieces joined by a junction.
+SyntheticSkeleton MakeSyntheticSkeleton(BranchKind kind, int numBranches, unsigned int seed,
+    int width = 1024, int height = 1024);
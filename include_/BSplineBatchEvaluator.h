@@ -0,0 +1,43 @@
+// Batch evaluation of an open uniform B-spline curve (the curves produced by
+// BSplineCurveFit/BSplineFitEngine) at uniformly spaced parameters.
+//
+// SetControls() converts every knot span of the curve into a polynomial in the
+// span's local parameter, once per curve. EvaluateUniform() then walks the
+// parameters span by span and evaluates the polynomials with Horner's rule over
+// a whole run of samples at a time. The loops run over samples with no
+// dependencies between them, so the compiler vectorizes them, and the results
+// go straight into the caller's buffer.
+//
+// The per-curve tables come from the fitting context's SplineArena and stay
+// valid until the caller's arena scope ends. The span polynomials are kept in
+// double whatever the control points' scalar type.
+
+#pragma once
+
+#include "SplineArena.h"
+
+template <int N, typename Real>
+class BSplineBatchEvaluator
+{
+public:
+    enum { MAX_DEGREE = 15 };
+
+    explicit BSplineBatchEvaluator(SplineArena& arena);
+
+    // controlData holds numControls points of N coordinates each.
+    void SetControls(int degree, int numControls, Real const* controlData);
+
+    // Write the positions at t = multiplier * i, i in [0, numSamples), to
+    // positions[N*i .. N*i+N-1]. t is computed in Real exactly like the
+    // per-sample loops it replaces.
+    void EvaluateUniform(unsigned int numSamples, Real multiplier, Real* positions);
+
+    // Write the position at one t in [0, 1] to position[0 .. N-1].
+    void Evaluate(double t, Real* position) const;
+
+private:
+    SplineArena& mArena;
+    int mDegree, mNumControls, mNumSpans;
+    double* mKnots;
+    double* mCoeffs;            // [span][dimension][power], in the local parameter
+};
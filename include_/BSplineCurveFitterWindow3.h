@@ -1,64 +1,361 @@
-// David Eberly, Geometric Tools, Redmond WA 98052
-// Copyright (c) 1998-2020
-// Distributed under the Boost Software License, Version 1.0.
-// https://www.boost.org/LICENSE_1_0.txt
-// https://www.geometrictools.com/License/Boost/LICENSE_1_0.txt
-// Version: 4.0.2019.08.13
-
-#pragma once
-
-#include <Applications/Window3.h>
-#include <Mathematics/BSplineCurveFit.h>
-#include <Mathematics/BSplineCurveGenerate.h>
-using namespace gte;
-using namespace std; 
-
-//class BSplineCurveFitterWindow3 : public Window3
-class BSplineCurveFitterWindow3
-{ 
-public:
-    //BSplineCurveFitterWindow3(Parameters& parameters);
-    ///BSplineCurveFitterWindow3(vector<vector<Vector3<float>>> BranchSet, float hausdorff_, float diagonal);
-    BSplineCurveFitterWindow3();
-    //virtual void OnIdle() override;
-    //virtual bool OnCharPress(unsigned char key, int x, int y) override;
-    int SplineFit(vector<vector<Vector3<float>>> BranchSet, float hausdorff_,float diagonal_, int layerNum, vector<int *> connection_);
-    int SplineFit2(vector<vector<Vector3<float>>> BranchSet, float hausdorff_,float diagonal_, int width, vector<int *> connection_, bool mergeOrNot, float *smd);
-    void indexingSpline(vector<vector<Vector3<float>>> BranchSet, float hausdorff_,float diagonal_, int layerNum, int index);
-
-    vector<vector<Vector3<float>>> SplineGenerate();
-	vector<Vector3<float>> ReadIndexingSpline(vector<vector<Vector3<float>>> cpList);
-    vector<vector<Vector3<float>>> ReadIndexingSpline();
-    inline void clear_IndexingCP() {if(!IndexingCP.empty()) IndexingCP.clear();}
-    inline void clear_IndexingCP_Interactive() 
-    { if(!IndexingCP_Interactive.empty()) IndexingCP_Interactive.clear(); }
-    inline vector<vector<vector<Vector3<float>>>> get_indexingCP() {return IndexingCP;}
-private:
-    
-    void CreateBSplinePolyline(vector<Vector3<float>> Sample);
-    void CalculateNeededCP(vector<Vector3<float>> Sample);
-    void CreateGraphics(unsigned int numSamples, int which);
-    float Judge(vector<Vector3<float>> Sample);
-	void Merge();
-/*
-    //void CreateScene();
-    void CreateGraphics(unsigned int numSamples);
-    float Judge(vector<Vector3<float>> Sample);
-    void Merge();
-    void CreateBSplinePolyline();
-    //void drawSpline();
-    void drawControlPoints(Vector3<float> controlPoint);
-    void drawControlPointsLine();
-
-    enum { NUM_SAMPLES = 10000};*/
-    vector<Vector3<float>> merge;
-    vector<vector<Vector3<float>>> sampleSet;
-    unique_ptr<BSplineCurveFit<float>> mSpline = nullptr;
-    float hausdorff = 0.0f;
-    float minErrorThreshold = 0.0f;
-    //float diagonal= 0.0f;
-    vector<int *> connection;
-    static vector<vector<vector<Vector3<float>>>> IndexingCP;
-    static vector<vector<vector<Vector3<float>>>> IndexingCP_Interactive;
-    
-};
+// David Eberly, Geometric Tools, Redmond WA 98052
+// Copyright (c) 1998-2020
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+// https://www.geometrictools.com/License/Boost/LICENSE_1_0.txt
+// Version: 4.0.2019.08.13
+
+#pragma once
+
+#include <Mathematics/BSplineCurveFit.h>
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include "BSplineBatchEvaluator.h"
+#include "BSplineFitEngine.h"
+#include "SplineArena.h"
+#include "SplineCPStream.h"
+#include "SplineFitCache.h"
+#include "SplineFitStats.h"
+#include "SplineHausdorff.h"
+#include "SplineLayerStore.h"
+#include "SplineRasterizer.h"
+#include "SplineThreadPool.h"
+using namespace gte;
+using namespace std; 
+
+//class BSplineCurveFitterWindow3 : public Window3
+class BSplineCurveFitterWindow3
+{ 
+public:
+    // How Judge() looks for the smallest number of control points that meets
+    // the error threshold. Linear tries 2, 3, ... in turn; Galloping brackets
+    // the count with 2, 3, 5, 9, ... and then bisects, which assumes the error
+    // does not grow when a control point is added.
+    enum class ControlSearch { Linear, Galloping };
+
+    // Least-squares solver behind Judge(). Incremental (the default) is
+    // BSplineFitEngine with BSplineBatchEvaluator; Reference builds and
+    // samples a gte::BSplineCurveFit per candidate and is kept to validate the
+    // former against. Reconstruction always uses BSplineBatchEvaluator.
+    enum class FitEngine { Incremental, Reference };
+
+    // Scalar type of Judge()'s fits and error measurements and of
+    // reconstruction. Double converts the samples once per Judge() and runs
+    // the <3, double> engines, for images whose diagonal is too large for
+    // float to resolve a pixel. The samples and the stored control points
+    // stay float either way. The Reference engine and the rasterizer always
+    // work in float.
+    enum class Precision { Single, Double };
+
+    // What CreateBSplinePolyline does with a branch that needs more than
+    // MAX_NUM_CONTROLS control points. Halving (the default) splits it in the
+    // middle and recurses. Greedy cuts off the longest prefix Judge() accepts,
+    // found by galloping and bisecting over its length, and repeats on the
+    // rest, at the cost of more Judge() calls per long branch. Greedy is a
+    // heuristic: it often needs fewer pieces and control triples, but the
+    // longest acceptable prefix can leave a remainder that fits worse, so on
+    // some branches and layers it emits more triples than Halving.
+    enum class Segmentation { Halving, Greedy };
+
+    // How Merge() joins branches at the junctions in 'connection'. A
+    // junction lists a head branch and up to three branches that may be
+    // appended to it. Sequential (the default) walks the junctions once, in
+    // order, and appends each head's best candidate. BestGain scores every
+    // (head, candidate) pair up front, on the worker fitters when
+    // set_numThreads asks for more than one, then keeps applying the merge
+    // that saves the most from a priority queue until no merge saves
+    // anything. After a merge only the pairs that involve the grown branch
+    // are rescored; queued scores of changed branches are dropped when they
+    // come up. A branch may grow more than once.
+    enum class MergeStrategy { Sequential, BestGain };
+
+    // Judge() lookups Merge() answered from its cache during the last
+    // SplineFit2 call with mergeOrNot set.
+    struct MergeCacheStats { unsigned long hits = 0, misses = 0; };
+
+    // Non-owning view of consecutive samples. Branches, the pieces they are
+    // split into and merge candidates are fitted through views, so fitting
+    // does not copy samples. The viewed samples must outlive the view. With a
+    // saliency map, a view also carries the saliency weight of each sample.
+    class SampleView
+    {
+    public:
+        SampleView() : mData(nullptr), mWeights(nullptr), mSize(0) {}
+        SampleView(Vector3<float> const* data, unsigned int size, double const* weights = nullptr)
+            : mData(data), mWeights(weights), mSize(size) {}
+        SampleView(vector<Vector3<float>> const& samples)
+            : mData(samples.data()), mWeights(nullptr), mSize((unsigned int)samples.size()) {}
+
+        inline Vector3<float> const* data() const { return mData; }
+        inline double const* weights() const { return mWeights; }
+        inline unsigned int size() const { return mSize; }
+        inline Vector3<float> const& operator[](unsigned int i) const { return mData[i]; }
+        inline SampleView Sub(unsigned int first, unsigned int count) const
+        { return SampleView(mData + first, count, mWeights ? mWeights + first : nullptr); }
+
+    private:
+        Vector3<float> const* mData;
+        double const* mWeights;
+        unsigned int mSize;
+    };
+
+    // How the saliency map passed to SplineFit2 enters Judge(). MeanFactor
+    // (the default) divides the threshold by the branch's mean weight.
+    // PerSample scales each sample's distance by its own weight, so salient
+    // parts of a branch are held to a tighter tolerance than the rest.
+    enum class SaliencyWeighting { MeanFactor, PerSample };
+
+    //BSplineCurveFitterWindow3(Parameters& parameters);
+    ///BSplineCurveFitterWindow3(vector<vector<Vector3<float>>> BranchSet, float hausdorff_, float diagonal);
+    BSplineCurveFitterWindow3();
+    //virtual void OnIdle() override;
+    //virtual bool OnCharPress(unsigned char key, int x, int y) override;
+    // The branches are fitted in place. SplineFit2 copies them only when
+    // mergeOrNot is set, because Merge() rewrites them; pass an rvalue to
+    // hand them over instead. SplineFit only counts the control points: it
+    // accepts the first degree that meets the threshold for each control
+    // count and keeps no control points.
+    int SplineFit(vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,float diagonal_, int layerNum, vector<int *> const& connection_);
+    int SplineFit2(vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd);
+    int SplineFit2(vector<vector<Vector3<float>>>&& BranchSet, float hausdorff_,float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd);
+    void indexingSpline(vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,float diagonal_, int layerNum, int index);
+
+    // Streaming fit. BeginStream takes the parameters of SplineFit2, then
+    // each FitBranch call fits one branch and passes its control blocks (the
+    // header triple followed by the control points, as in an IndexingCP
+    // branch) to 'sink' before returning; it returns the number of triples
+    // emitted. Nothing is kept between branches, so memory does not grow with
+    // the number of branches or layers. Branches are fitted serially, in call
+    // order and without Merge(). EndStream returns the triples since
+    // BeginStream.
+    typedef function<void(vector<Vector3<float>> const& block)> ControlBlockSink;
+    void BeginStream(float hausdorff_, float diagonal_, ControlBlockSink sink, int width = 0, float *smd = nullptr);
+    int FitBranch(Vector3<float> const* samples, size_t numSamples);
+    int FitBranch(vector<Vector3<float>> const& branch);
+    int EndStream();
+
+    vector<vector<Vector3<float>>> SplineGenerate();
+	vector<Vector3<float>> ReadIndexingSpline(vector<vector<Vector3<float>>> const& cpList);
+    vector<vector<Vector3<float>>> ReadIndexingSpline();
+    // Reconstruct the layers at a level of detail, see set_coarseLevels();
+    // level 0 is ReadIndexingSpline().
+    vector<vector<Vector3<float>>> ReadIndexingSpline(unsigned int level);
+    // Reconstruct from a packed stream (see SplineCPStream.h) without
+    // unpacking it into nested vectors first.
+    vector<Vector3<float>> ReadIndexingSpline(SplineCPReader const& reader, size_t layer);
+    vector<vector<Vector3<float>>> ReadIndexingSpline(SplineCPReader const& reader);
+    // Rasterize the layers of a level straight into pixels instead of
+    // returning samples (see SplineRasterizer.h). The sink gets the layer,
+    // every pixel each curve enters and the radius there. The mask overload
+    // sets mask[y*width + x] to 1 for the pixels of one layer that fall
+    // inside the mask, and returns false if there is no such layer.
+    typedef function<void(unsigned int layer, int x, int y, int radius)> PixelSink;
+    void RasterizeIndexingSpline(PixelSink const& sink, unsigned int level = 0);
+    bool RasterizeIndexingSpline(unsigned int layer, unsigned char* mask, int width, int height, unsigned int level = 0);
+    inline bool WriteIndexingCP(string const& path) const {return WriteSplineCP(path, IndexingCP, diagonal);}
+    inline void clear_IndexingCP() {if(!IndexingCP.empty()) IndexingCP.clear(); IndexingCPLevels.clear();}
+    inline void clear_IndexingCP_Interactive() 
+    { IndexingCP_Interactive.Clear(); }
+    // Drop the samples SplineGenerate() cached, so that its next call
+    // decodes every layer again.
+    inline void clear_generatedSamples() { IndexingCP_Interactive.ClearSamples(); }
+    // Keyed layers of IndexingCP_Interactive. SplineFit2 appends a layer
+    // under a new key (get_lastLayerKey() tells which); UpdateLayer fits the
+    // branches like SplineFit2 and replaces the layer stored under 'key', or
+    // appends one if there is none. SplineGenerate() caches the samples of
+    // each layer and only rebuilds the layers put since its last call.
+    int UpdateLayer(unsigned int key, vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd);
+    inline bool RemoveLayer(unsigned int key) { return IndexingCP_Interactive.Remove(key); }
+    inline unsigned int get_lastLayerKey() const { return lastLayerKey; }
+    inline vector<vector<vector<Vector3<float>>>> const& get_indexingCP() const {return IndexingCP;}
+    // Hand the index over without copying it; IndexingCP (and its coarse
+    // levels) are left empty.
+    inline vector<vector<vector<Vector3<float>>>> take_indexingCP()
+    { vector<vector<vector<Vector3<float>>>> index; index.swap(IndexingCP); IndexingCPLevels.clear(); return index; }
+    // pruneDegrees stops the degree sweep for a control count as soon as
+    // raising the degree no longer lowers the error.
+    inline void set_controlSearch(ControlSearch search, bool pruneDegrees_ = false)
+    { controlSearch = search; pruneDegrees = pruneDegrees_; }
+    // Number of threads SplineFit, SplineFit2 and indexingSpline use to fit
+    // the branches of a layer, and ReadIndexingSpline() and SplineGenerate()
+    // use to decode the blocks of all layers; 1 (the default) works serially
+    // and 0 uses every core. The output does not depend on the thread count.
+    void set_numThreads(unsigned int numThreads_);
+    inline void set_fitEngine(FitEngine engine) { fitEngine = engine; }
+    inline void set_precision(Precision precision_) { precision = precision_; }
+    inline void set_segmentation(Segmentation segmentation_) { segmentation = segmentation_; }
+    inline void set_mergeStrategy(MergeStrategy strategy) { mergeStrategy = strategy; }
+    inline void set_saliencyWeighting(SaliencyWeighting weighting) { saliencyWeighting = weighting; }
+    // Progressive output of indexingSpline. For scales s1 < s2 < ... (values
+    // not above 1 are dropped), each branch is also fitted at the tolerances
+    // hausdorff_*s1, hausdorff_*s2, ..., stored as levels 1, 2, ... next to
+    // the regular output (level 0). All levels come out of the same control
+    // count sweep; a piece is split only for the levels it does not meet, so
+    // each level's pieces are unions of the finer level's pieces. The sweep
+    // is linear and splits in the half, whatever set_controlSearch and
+    // set_segmentation say.
+    void set_coarseLevels(vector<float> const& scales);
+    inline unsigned int get_numLevels() const { return 1 + (unsigned int)IndexingCPLevels.size(); }
+    inline MergeCacheStats get_mergeCacheStats() const {return mergeCacheStats;}
+    // Reuse the fit of a branch that reappears with the same samples,
+    // threshold, diagonal, settings and saliency, e.g. in the next threshold
+    // layer. The cache holds at most about maxBytes of fitted blocks and
+    // samples; 0 (the default) turns it off. Branches fitted through
+    // FitBranch are not cached.
+    inline void set_fitCache(size_t maxBytes) { fitCache.SetMaxBytes(maxBytes); }
+    inline void clear_fitCache() { fitCache.Clear(); }
+    inline SplineFitCache::Stats const& get_fitCacheStats() const { return fitCache.GetStats(); }
+    // Statistics since the last SplineFit, SplineFit2 or indexingSpline call;
+    // decoding afterwards adds to reconstructionSeconds. All zero unless the
+    // library is built with SPLINE_ENABLE_STATS. get_fitStats().ToJson()
+    // gives them as a JSON object.
+    inline SplineFitStats const& get_fitStats() const {return fitStats;}
+    // Scratch-memory counters of this fitter and its workers. Once a layer of
+    // similar size has been fitted, heapAllocations stops growing: with the
+    // Incremental engine the candidate fits and their evaluation then take
+    // no new scratch blocks (the Reference engine still allocates a
+    // gte::BSplineCurveFit per candidate). These counters cover the arenas
+    // only; the emitted control blocks, Merge()'s judge cache and merged
+    // branches, and the stored layers are ordinary heap allocations.
+    SplineArena::Stats get_arenaStats() const;
+private:
+    
+    enum { NEW_LAYER = 0xffffffff };
+    // Judge()'s engines in one precision, and the samples and squared
+    // weights of the Judge() in progress converted to it (see BindSamples).
+    template <typename Real>
+    struct JudgeEngines
+    {
+        explicit JudgeEngines(SplineArena& arena) : fit(arena), evaluate(arena), hausdorff(arena) {}
+        BSplineFitEngine<3, Real> fit;
+        BSplineBatchEvaluator<3, Real> evaluate;
+        SplineHausdorff<3, Real> hausdorff;
+        Vector3<Real> const* samples = nullptr;
+        Real const* sqrWeights = nullptr;
+    };
+    int FitLayer(vector<vector<Vector3<float>>> const& branches, float hausdorff_, float diagonal_, int width,
+        vector<int *> const& connection_, bool mergeOrNot, float *smd, unsigned int key);
+    void CreateBSplinePolyline(SampleView Sample, unsigned int depth = 0);
+    void CalculateNeededCP(SampleView Sample, unsigned int depth = 0);
+    void SegmentGreedy(SampleView Sample, bool countOnly, unsigned int depth);
+    unsigned int ClampPiece(unsigned int length, unsigned int remaining);
+    void EmitControlBlock(unsigned int numSamples);
+    static unsigned int NumGraphicsSamples(unsigned int numSamples);
+    // The control points and the samples are in pixel units, so decoding
+    // does not depend on the diagonal.
+    void CreateGraphics(int degree, int numControls, float const* controlData, unsigned int numSamples, Vector3<float>* target);
+    void AppendGraphics(int degree, int numControls, float const* controlData, unsigned int numSamples, vector<Vector3<float>>& target);
+    double SaliencyWeight(Vector3<float> const& sample) const;
+    SampleView WeighBranch(SampleView branch);
+    float Judge(SampleView Sample);
+    void BindSamples(SampleView Sample);
+    float JudgeControls(SampleView Sample, int numControls, int& minDegree, float bound);
+    template <typename Real>
+    float JudgeControls(JudgeEngines<Real>& engines, SampleView Sample, int numControls, int& minDegree, float bound);
+    void FitBranches(vector<vector<Vector3<float>>> const& branches, bool countOnly);
+    uint64_t FitCacheContext(bool countOnly) const;
+    uint64_t BranchCacheContext(uint64_t context, vector<Vector3<float>> const& branch) const;
+    void FitOneBranch(SampleView branch, bool countOnly);
+    float SaliencyFactor(SampleView Sample);
+    unsigned int JudgeLevels(SampleView Sample, unsigned int numOpen);
+    void CreateLevelPolyline(SampleView Sample, unsigned int depth, unsigned int numOpen);
+    vector<vector<Vector3<float>>> DecodeIndex(vector<vector<vector<Vector3<float>>>> const& index);
+    void DecodeLayers(vector<vector<vector<Vector3<float>>> const*> const& layers, vector<vector<Vector3<float>>>& samples);
+    void DecodeBlock(vector<Vector3<float>> const& block, Vector3<float>* target);
+    vector<vector<vector<Vector3<float>>>> const* IndexLevel(unsigned int level) const;
+    void PrepareWorkers();
+	void Merge();
+    void MergeSequential();
+    void MergeBestGain();
+    float MergeGain(unsigned int first, unsigned int second);
+    float JudgeMergeCandidate(unsigned int first, unsigned int second);
+    float ScoreMergeCandidate(SampleView head, SampleView tail);
+    void ScoreMergeCandidates(vector<array<unsigned int, 2>> const& candidates);
+/*
+    //void CreateScene();
+    void CreateGraphics(unsigned int numSamples);
+    float Judge(vector<Vector3<float>> Sample);
+    void Merge();
+    void CreateBSplinePolyline();
+    //void drawSpline();
+    void drawControlPoints(Vector3<float> controlPoint);
+    void drawControlPointsLine();
+
+    enum { NUM_SAMPLES = 10000};*/
+    // Merge() scores keyed by (branch, version, second branch, version);
+    // a branch's version is bumped whenever a merge rewrites it.
+    enum { NO_BRANCH = 0xffffffff };
+    vector<unsigned int> branchVersion;
+    map<array<unsigned int, 4>, float> judgeCache;
+    MergeCacheStats mergeCacheStats;
+    SplineFitCache fitCache;
+    SplineFitStats fitStats;
+    vector<vector<Vector3<float>>> sampleSet;
+    enum { DIMENSION = 3, MAX_NUM_CONTROLS = 15, MAX_DEGREE = 10, MIN_PIECE_LENGTH = 2 };
+    // Scratch memory of this fitter's engines and of Judge(); reset at the
+    // start of every layer. Declared first, the engines allocate from it.
+    SplineArena mArena;
+    unique_ptr<BSplineCurveFit<float>> mSpline = nullptr;
+    JudgeEngines<float> mSingle;
+    JudgeEngines<double> mDouble;
+    // Control points of the best degree of the current control count, and of
+    // the candidate Judge() settled on.
+    array<float, MAX_NUM_CONTROLS * 3> roundControlData, DeterminedControlData;
+
+    // Levels of detail: the fit JudgeLevels() settled on for each level, and
+    // the coarse levels' blocks of the layer being fitted.
+    struct LevelFit
+    {
+        int numControls = 0, degree = 0;
+        array<float, MAX_NUM_CONTROLS * 3> controlData;
+    };
+    vector<float> coarseScales;
+    bool levelsActive = false;
+    vector<LevelFit> levelFits;
+    vector<vector<vector<Vector3<float>>>> CPforEachLevel;
+    float hausdorff = 0.0f;
+    float minErrorThreshold = 0.0f;
+    float diagonal = 0.0f;
+    vector<int *> connection;
+    ControlBlockSink streamSink;
+    ControlSearch controlSearch = ControlSearch::Linear;
+    bool pruneDegrees = false;
+    FitEngine fitEngine = FitEngine::Incremental;
+    Precision precision = Precision::Single;
+    Segmentation segmentation = Segmentation::Halving;
+    MergeStrategy mergeStrategy = MergeStrategy::Sequential;
+    SaliencyWeighting saliencyWeighting = SaliencyWeighting::MeanFactor;
+    float const* sampleSqrWeights = nullptr;    // PerSample weights of the Judge() in progress
+    bool countOnlyMode = false;                 // SplineFit: only the control counts are wanted
+
+    // Fitting state. Every fitter owns its own copy, so independent
+    // instances can run on different threads.
+    float *smd_ = nullptr;
+    int width_ = 0;
+    int TotalControlNum = 0, TotalTriple = 0;
+    int DeterminedNumControls = 0, DeterminedDegree = 0;
+    float minError = 0.0f;
+    float storevector[3] = {0,0,0};
+    vector<vector<Vector3<float>>> CPforEachLayer_or_CC = {{}};
+
+    // Reconstruction state.
+    BSplineBatchEvaluator<3, float> mGenerate;
+    BSplineBatchEvaluator<3, double> mGenerateDouble;
+    SplineRasterizer mRasterizer;
+    vector<Vector3<float>> ReadingSampleforEachInty = {{}};    // leads the first layer SplineGenerate() decodes
+
+    // Parallel fitting: one private fitter per pool worker.
+    unsigned int numThreads = 1;
+    unique_ptr<SplineThreadPool> mPool;
+    vector<unique_ptr<BSplineCurveFitterWindow3>> mWorkers;
+
+    vector<vector<vector<Vector3<float>>>> IndexingCP = {{}};
+    vector<vector<vector<vector<Vector3<float>>>>> IndexingCPLevels;  // [level - 1][layer][branch]
+    SplineLayerStore IndexingCP_Interactive;
+    unsigned int lastLayerKey = 0;
+};
@@ -0,0 +1,60 @@
+// Least-squares B-spline fitting engine used by BSplineCurveFitterWindow3::Judge.
+//
+// It produces the same curve as gte::BSplineCurveFit (open uniform knots,
+// samples parameterized uniformly on [0,1], end control points pinned to the
+// end samples), but is built for the (degree, numControls) sweep of Judge():
+// the samples and their parameters are bound once per branch, and every
+// candidate reuses the same scratch buffers. Each fit evaluates the basis once
+// per sample and accumulates the banded normal equations A^T*A*Q = A^T*P
+// directly, followed by a banded Cholesky solve in double precision, instead
+// of forming (A^T*A)^{-1}*A^T column by column.
+//
+// Buffers come from the fitting context's SplineArena: those of SetSamples()
+// and Fit() stay valid until the caller's arena scope ends, so a caller takes
+// one scope per branch and one per candidate inside it. Samples are
+// Vector<N, Real>; the normal equations are solved in double for any Real.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include "SplineArena.h"
+using namespace gte;
+using namespace std;
+
+template <int N, typename Real>
+class BSplineFitEngine
+{
+public:
+    enum { MAX_DEGREE = 15 };
+
+    explicit BSplineFitEngine(SplineArena& arena);
+
+    // Bind the samples of one branch. The pointer must stay valid while fitting.
+    void SetSamples(Vector<N, Real> const* samples, unsigned int numSamples);
+
+    // Fit the bound samples. Returns false when the normal equations are
+    // singular, e.g. when there are fewer samples than control points.
+    bool Fit(int degree, int numControls);
+
+    inline Real const* GetControlData() const { return mControlData; }
+    inline int GetDegree() const { return mDegree; }
+    inline int GetNumControls() const { return mNumControls; }
+
+    // Same contract as BSplineCurveFit::GetPosition, for the last fit.
+    void GetPosition(Real t, Real* position) const;
+
+private:
+    int FindSpan(double t) const;
+    void EvaluateBasis(int span, double t, double* values) const;
+
+    SplineArena& mArena;
+    Vector<N, Real> const* mSamples;
+    unsigned int mNumSamples;
+    Real* mParams;
+
+    int mDegree, mNumControls;
+    double* mKnots;
+    double* mBand;          // lower band of A^T*A, row i holds columns i-degree..i
+    double* mRhs;           // A^T*P, then the solution
+    Real* mControlData;
+};
@@ -0,0 +1,77 @@
+// Scratch memory of one fitting context (a BSplineCurveFitterWindow3 and the
+// engines it owns).
+//
+// A bump allocator over a list of blocks. Callers take a Scope around each
+// unit of work (a Judge() call, one candidate fit, one decoded branch) and
+// everything allocated inside is released in one step when the scope ends,
+// so buffers are handed out in the same stack order the fitting recursion
+// uses them. Reset() between layers folds the blocks into a single one as
+// large as everything the layer held, after which the scratch buffers of
+// fitting come from that block. GetStats() reports how often the arena went
+// to the heap; allocations made outside the arena are not counted.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+class SplineArena
+{
+public:
+    struct Stats
+    {
+        unsigned long heapAllocations = 0;  // blocks obtained from the heap
+        unsigned long allocations = 0;      // Allocate() calls served
+        size_t reservedBytes = 0;           // bytes held in blocks now
+        size_t peakBytes = 0;               // most bytes in use at once
+    };
+
+    struct Marker { size_t block, offset; };
+
+    // Releases everything allocated after its construction when it ends.
+    class Scope
+    {
+    public:
+        explicit Scope(SplineArena& arena) : mArena(arena), mMarker(arena.Mark()) {}
+        ~Scope() { mArena.Rewind(mMarker); }
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        SplineArena& mArena;
+        Marker mMarker;
+    };
+
+    SplineArena();
+    ~SplineArena();
+    SplineArena(SplineArena const&) = delete;
+    SplineArena& operator=(SplineArena const&) = delete;
+
+    // Uninitialized storage for 'count' objects of a trivially destructible
+    // type, valid until the enclosing scope ends or Reset() is called.
+    template <typename T>
+    inline T* Allocate(size_t count)
+    {
+        return static_cast<T*>(AllocateBytes(count * sizeof(T)));
+    }
+
+    inline Marker Mark() const { return Marker{mBlock, mOffset}; }
+    void Rewind(Marker marker);
+
+    // Release everything; keeps (at most) one block for the next layer.
+    void Reset();
+    inline Stats const& GetStats() const { return mStats; }
+
+private:
+    enum { ALIGNMENT = 16, MIN_BLOCK_SIZE = 64 * 1024 };
+
+    struct Block { unsigned char* data; size_t size; };
+
+    void* AllocateBytes(size_t size);
+    size_t BytesInUse() const;
+
+    vector<Block> mBlocks;
+    size_t mBlock, mOffset;     // current block and the first free byte in it
+    Stats mStats;
+};
@@ -0,0 +1,96 @@
+// Packed binary encoding of a control-point index (IndexingCP and friends:
+// layers -> branches -> [header (CPnum, degree, numSamples), control points]).
+//
+//   file   := "SPCP" | u8 version | u8[3] reserved | f32 diagonal | varint numLayers | layer*
+//   layer  := varint numBytes | varint numBranches | branch*
+//   branch := varint numEntries                      (0 for an empty branch)
+//             [varint CPnum | varint degree | varint numSamples | point * (numEntries-1)]
+//   point  := 3 zigzag varints, the delta to the previous point of the layer
+//
+// numBytes counts the layer bytes that follow it, so a reader can index the
+// layers without decoding them. Floats are little-endian, varints are LEB128.
+// Control points are rounded to pixels by the fitter, so only integral
+// coordinates can be encoded.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+using namespace gte;
+using namespace std;
+
+// Whether a non-empty branch header describes a block the decoders can
+// reconstruct: CPnum == numEntries-1 control points, and for more than one
+// control point 1 <= degree < CPnum, degree <= SPLINE_CP_MAX_DEGREE (the
+// evaluators' limit) and numSamples <= SPLINE_CP_MAX_NUM_SAMPLES. A single
+// control point is decoded as that point.
+enum { SPLINE_CP_MAX_DEGREE = 15, SPLINE_CP_MAX_NUM_SAMPLES = 1 << 24 };
+bool IsValidSplineCPBranch(unsigned int numEntries, long long CPnum, long long degree, long long numSamples);
+
+// Encode 'index' into 'bytes'. Returns false if a header value is negative,
+// a value is not an integer in the 32-bit range or a branch header is not
+// valid (see IsValidSplineCPBranch).
+bool EncodeSplineCP(vector<vector<vector<Vector3<float>>>> const& index, float diagonal, vector<unsigned char>& bytes);
+bool WriteSplineCP(string const& path, vector<vector<vector<Vector3<float>>>> const& index, float diagonal);
+
+struct SplineCPBranch
+{
+    unsigned int numEntries;    // header + control points, 0 for an empty branch
+    int CPnum, degree;
+    unsigned int numSamples;
+};
+
+// Decodes a stream in place, either from a caller-owned buffer or from a
+// memory-mapped file, without building the nested vectors.
+class SplineCPReader
+{
+public:
+    // Sequential access to the branches of one layer.
+    class Cursor
+    {
+    public:
+        Cursor();
+        inline unsigned int GetNumBranches() const { return mNumBranches; }
+
+        // Decode the next branch. The control points are written to 'points'
+        // as x,y,z triples; the buffer is reused, so decoding a layer does not
+        // allocate once it has grown. Returns false at the end of the layer or
+        // on malformed data, including branch headers IsValidSplineCPBranch
+        // rejects.
+        bool Next(SplineCPBranch& branch, vector<float>& points);
+
+    private:
+        friend class SplineCPReader;
+        unsigned char const* mCurrent;
+        unsigned char const* mEnd;
+        unsigned int mNumBranches, mNumRead;
+        long long mPrevious[3];
+    };
+
+    SplineCPReader();
+    ~SplineCPReader();
+    SplineCPReader(SplineCPReader const&) = delete;
+    SplineCPReader& operator=(SplineCPReader const&) = delete;
+
+    // Map a file written by WriteSplineCP.
+    bool Open(string const& path);
+    // Read a stream held in memory; 'data' must outlive the reader.
+    bool Attach(unsigned char const* data, size_t size);
+    void Close();
+
+    inline float GetDiagonal() const { return mDiagonal; }
+    inline size_t GetNumLayers() const { return mLayers.size(); }
+    Cursor GetLayer(size_t layer) const;
+
+private:
+    bool Index();
+
+    unsigned char const* mData;
+    size_t mSize;
+    void* mMapping;
+    float mDiagonal;
+    vector<size_t> mLayers;     // offset of each layer's numBranches field
+    vector<size_t> mLayerEnds;
+};
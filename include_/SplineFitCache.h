@@ -0,0 +1,81 @@
+// Cache of fitted branches kept by a BSplineCurveFitterWindow3 across its
+// SplineFit, SplineFit2 and indexingSpline calls.
+//
+// Neighbouring threshold layers of a skeleton share many identical branches.
+// An entry maps a branch's samples, together with a 64-bit context hash of
+// everything else its fit depends on (threshold, diagonal, fitter settings
+// and the saliency under the samples), to the control blocks fitted for it.
+// The samples are stored with the entry and compared on lookup, so a hash
+// collision costs a miss, never a wrong fit. Entries are evicted least
+// recently used first once their estimated size exceeds the byte budget; a
+// budget of 0 (the default) disables the cache.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+using namespace gte;
+using namespace std;
+
+class SplineFitCache
+{
+public:
+    struct Entry
+    {
+        int count = 0;                                  // control points (SplineFit) or triples
+        vector<vector<vector<Vector3<float>>>> blocks;  // [level][branch][header, control points]
+    };
+
+    struct Stats
+    {
+        unsigned long lookups = 0;
+        unsigned long hits = 0;
+        unsigned long insertions = 0;
+        unsigned long evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;               // estimated size of the entries held
+    };
+
+    SplineFitCache();
+
+    // Evicts entries until the cache fits in the new budget.
+    void SetMaxBytes(size_t maxBytes);
+    inline size_t GetMaxBytes() const { return mMaxBytes; }
+    inline bool IsEnabled() const { return mMaxBytes > 0; }
+    // Drops every entry; the statistics are kept.
+    void Clear();
+    inline Stats const& GetStats() const { return mStats; }
+
+    // FNV-1a over 'numBytes' bytes, continuing from 'hash'.
+    static uint64_t Hash(void const* data, size_t numBytes, uint64_t hash = 14695981039346656037ull);
+
+    // The entry fitted for these samples in this context, or nullptr. The
+    // pointer stays valid until the next Insert, SetMaxBytes or Clear.
+    Entry const* Find(uint64_t context, Vector3<float> const* samples, size_t numSamples);
+    // Replaces an entry with the same key. Entries larger than the whole
+    // budget are not stored.
+    void Insert(uint64_t context, Vector3<float> const* samples, size_t numSamples, Entry&& entry);
+
+private:
+    struct Node
+    {
+        uint64_t hash;
+        uint64_t context;
+        vector<Vector3<float>> samples;
+        Entry entry;
+        size_t bytes;
+    };
+    typedef list<Node>::iterator NodeIterator;
+
+    NodeIterator Lookup(uint64_t hash, uint64_t context, Vector3<float> const* samples, size_t numSamples);
+    void Erase(NodeIterator node);
+    void Evict();
+
+    size_t mMaxBytes;
+    list<Node> mNodes;                                  // most recently used first
+    unordered_multimap<uint64_t, NodeIterator> mIndex;  // by hash of context and samples
+    Stats mStats;
+};
@@ -0,0 +1,49 @@
+// Per-call statistics of the fitter, filled when the library is built with
+// SPLINE_ENABLE_STATS (CMake option of the same name). Without it the
+// SPLINE_STATS/SPLINE_TIMED hooks expand to nothing and the counters stay 0.
+
+#pragma once
+
+#include <chrono>
+#include <string>
+using namespace std;
+
+struct SplineFitStats
+{
+    unsigned long judgeCalls = 0;           // Judge() invocations
+    unsigned long candidateFits = 0;        // (degree, numControls) fits tried
+    unsigned int maxSplitDepth = 0;         // deepest split-in-half recursion
+    unsigned long distanceEvaluations = 0;  // point-to-point distances computed
+    double fitSeconds = 0.0;                // least-squares fits
+    double errorSeconds = 0.0;              // Hausdorff error evaluation
+    double reconstructionSeconds = 0.0;     // sampling fitted and decoded splines
+
+    // Fold in the statistics of a worker.
+    void Add(SplineFitStats const& other);
+    string ToJson() const;
+};
+
+#ifdef SPLINE_ENABLE_STATS
+
+class SplineStatsTimer
+{
+public:
+    explicit SplineStatsTimer(double& total)
+        : mTotal(total), mStart(chrono::steady_clock::now()) {}
+    ~SplineStatsTimer()
+    { mTotal += chrono::duration<double>(chrono::steady_clock::now() - mStart).count(); }
+
+private:
+    double& mTotal;
+    chrono::steady_clock::time_point mStart;
+};
+
+#define SPLINE_STATS(statement) statement
+#define SPLINE_TIMED(total) SplineStatsTimer splineStatsTimer(total)
+
+#else
+
+#define SPLINE_STATS(statement)
+#define SPLINE_TIMED(total)
+
+#endif
@@ -0,0 +1,64 @@
+// Closest-point engine used by BSplineCurveFitterWindow3::Judge to measure the
+// one-sided Hausdorff distance from the skeleton samples to a sampled spline.
+//
+// The spline samples are ordered along the curve, so they are grouped into
+// short runs of consecutive samples and an implicit bounding-box tree is built
+// over the runs in linear time. Each query is warm-started at the run that held
+// the nearest spline sample of the previous skeleton sample (both point sets
+// are ordered along the curve), which gives a tight upper bound before the tree
+// is searched. The search is exact: it returns the same squared distances as
+// comparing every pair of points. The tree lives in the fitting context's
+// SplineArena until the caller's arena scope ends. Distances are computed in
+// the points' own scalar type.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include <limits>
+#include "SplineArena.h"
+using namespace gte;
+using namespace std;
+
+template <int N, typename Real>
+class SplineHausdorff
+{
+public:
+    explicit SplineHausdorff(SplineArena& arena);
+
+    // Index the spline samples. The pointer must stay valid while querying.
+    void Build(Vector<N, Real> const* splineSamples, unsigned int numSplineSamples);
+
+    // Squared distance from 'point' to the nearest spline sample, or 'cap' if
+    // no spline sample is closer than that. 'hint' is the index of a spline
+    // sample expected to be close; on return it holds the nearest index found.
+    Real SquaredDistance(Vector<N, Real> const& point, Real cap, unsigned int& hint) const;
+
+    // Max over 'samples' of SquaredDistance(sample, cap), i.e. the squared
+    // one-sided Hausdorff distance. With 'sqrWeights', each squared distance
+    // is multiplied by the sample's squared weight first. With a finite
+    // 'bound' the scan stops as soon as the distance is proven to be at
+    // least 'bound' (not squared); the result is then only known to have a
+    // square root >= 'bound'. Results below 'bound' are exact.
+    Real MaxSquaredDistance(Vector<N, Real> const* samples, unsigned int numSamples, Real cap,
+        Real const* sqrWeights = nullptr, Real bound = numeric_limits<Real>::infinity()) const;
+
+    // Point-to-point distances computed so far; only counted when built with
+    // SPLINE_ENABLE_STATS.
+    inline unsigned long GetNumDistances() const { return mNumDistances; }
+
+private:
+    enum { RUN_SIZE = 8 };
+
+    Real BoxSquaredDistance(unsigned int node, Vector<N, Real> const& point) const;
+    void ScanRun(unsigned int run, Vector<N, Real> const& point, Real& best, unsigned int& bestIndex) const;
+
+    SplineArena& mArena;
+    Vector<N, Real> const* mSamples;
+    unsigned int mNumSamples;
+    unsigned int mNumRuns;
+    unsigned int mNumLeaves;        // mNumRuns rounded up to a power of two
+    Vector<N, Real>* mBoxMin;        // implicit tree, node 1 is the root
+    Vector<N, Real>* mBoxMax;
+    unsigned int* mStack;           // search stack, one entry per level and one more
+    mutable unsigned long mNumDistances;
+};
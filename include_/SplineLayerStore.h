@@ -0,0 +1,54 @@
+// Keyed store of fitted layers, the backing of
+// BSplineCurveFitterWindow3::IndexingCP_Interactive.
+//
+// Each layer holds the control blocks of one SplineFit2 call under a key,
+// together with the samples reconstructed from them. Putting a layer marks
+// its samples dirty; SplineGenerate() rebuilds only dirty layers and serves
+// the others from the cache. Layers keep the order in which their keys were
+// first put.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include <vector>
+using namespace gte;
+using namespace std;
+
+class SplineLayerStore
+{
+public:
+    SplineLayerStore();
+
+    // Insert the layer under 'key', or replace the layer stored under it.
+    void Put(unsigned int key, vector<vector<Vector3<float>>>&& blocks);
+    // Insert the layer under the next unused key and return that key.
+    unsigned int Append(vector<vector<Vector3<float>>>&& blocks);
+    // Returns false if no layer is stored under 'key'.
+    bool Remove(unsigned int key);
+    void Clear();
+
+    inline size_t GetNumLayers() const { return mLayers.size(); }
+    // Position of the layer stored under 'key', or GetNumLayers() if none.
+    size_t Find(unsigned int key) const;
+    inline unsigned int GetKey(size_t i) const { return mLayers[i].key; }
+    inline vector<vector<Vector3<float>>> const& GetBlocks(size_t i) const { return mLayers[i].blocks; }
+
+    // Cached reconstruction of layer i. It is dirty after the layer was put
+    // and after ClearSamples(), which drops the samples of every layer.
+    inline bool IsDirty(size_t i) const { return mLayers[i].dirty; }
+    void ClearSamples();
+    inline vector<Vector3<float>> const& GetSamples(size_t i) const { return mLayers[i].samples; }
+    void SetSamples(size_t i, vector<Vector3<float>>&& samples);
+
+private:
+    struct Layer
+    {
+        unsigned int key;
+        bool dirty;
+        vector<vector<Vector3<float>>> blocks;      // [branch][header, control points]
+        vector<Vector3<float>> samples;
+    };
+
+    vector<Layer> mLayers;
+    unsigned int mNextKey;
+};
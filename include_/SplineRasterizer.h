@@ -0,0 +1,44 @@
+// Rasterizing decoder for the control blocks of an index (IndexingCP).
+//
+// Instead of sampling a curve at a fixed 1.1x rate and keeping every sample,
+// Rasterize() walks the curve with a parameter step that adapts to its speed:
+// the step halves while the next position would skip a pixel and doubles,
+// up to the sampling decoder's step, while it stays in the same one.
+// Consecutive positions therefore fall on the same or a 4-neighbouring
+// pixel, and each pixel entered is reported once, without building sample
+// vectors. The cap keeps the walk no coarser than the sampling decoder; a
+// stretch of the curve that leaves a pixel and comes back within one step
+// can still be missed.
+// Pixel coordinates are truncated like the sampling decoder truncates its
+// samples. A curve that crosses itself enters some pixels twice.
+//
+// The evaluator tables live in the decoding context's SplineArena, inside a
+// scope per block.
+
+#pragma once
+
+#include <Mathematics/Vector3.h>
+#include <functional>
+#include <vector>
+#include "BSplineBatchEvaluator.h"
+#include "SplineArena.h"
+using namespace gte;
+using namespace std;
+
+class SplineRasterizer
+{
+public:
+    // Called with the pixel and the curve's radius (third coordinate) there.
+    typedef function<void(int x, int y, int radius)> PixelSink;
+
+    explicit SplineRasterizer(SplineArena& arena);
+
+    // Rasterize one control block: [numControls, degree, numSamples] followed
+    // by numControls control points in pixel units. A block with a single
+    // control point is that pixel.
+    void Rasterize(vector<Vector3<float>> const& block, PixelSink const& sink);
+
+private:
+    SplineArena& mArena;
+    BSplineBatchEvaluator<3, float> mEvaluate;
+};
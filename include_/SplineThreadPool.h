@@ -0,0 +1,58 @@
+// Small work-stealing thread pool used to fit and decode independent branches.
+//
+// Run() deals the task indices round-robin, in the order given, onto one queue
+// per worker. A worker takes tasks from the front of its own queue and, once
+// that is empty, steals from the back of the other queues. Callers pass the
+// most expensive tasks first, so every worker starts on a large task and the
+// cheap tail is what gets stolen. The calling thread works as worker 0.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class SplineThreadPool
+{
+public:
+    // numWorkers counts the calling thread; 0 uses one worker per core.
+    explicit SplineThreadPool(unsigned int numWorkers);
+    ~SplineThreadPool();
+
+    inline unsigned int GetNumWorkers() const { return mNumWorkers; }
+
+    // Calls task(index, worker) for every index in 'order' and returns once all
+    // of them have finished. 'worker' is in [0, GetNumWorkers()) and no two
+    // tasks run on the same worker at once, so it can select per-worker
+    // scratch state. The first exception thrown by a task is rethrown here.
+    void Run(vector<unsigned int> const& order, function<void(unsigned int, unsigned int)> const& task);
+
+private:
+    struct Queue
+    {
+        mutex lock;
+        deque<unsigned int> tasks;
+    };
+
+    void WorkerLoop(unsigned int worker);
+    void Drain(unsigned int worker);
+    bool Next(unsigned int worker, unsigned int& index);
+
+    unsigned int mNumWorkers;
+    vector<thread> mThreads;
+    vector<unique_ptr<Queue>> mQueues;
+
+    mutex mLock;
+    condition_variable mWake, mDone;
+    function<void(unsigned int, unsigned int)> const* mTask;
+    unsigned int mGeneration;
+    unsigned int mBusy;
+    bool mStop;
+    exception_ptr mError;
+};
@@ -0,0 +1,156 @@
+#include "BSplineBatchEvaluator.h"
+#include <algorithm>
+
+template <int N, typename Real>
+BSplineBatchEvaluator<N, Real>::BSplineBatchEvaluator(SplineArena& arena)
+    :
+    mArena(arena),
+    mDegree(0),
+    mNumControls(0),
+    mNumSpans(0),
+    mKnots(nullptr),
+    mCoeffs(nullptr)
+{
+}
+
+template <int N, typename Real>
+void BSplineBatchEvaluator<N, Real>::SetControls(int degree, int numControls, Real const* controlData)
+{
+    mDegree = degree;
+    mNumControls = numControls;
+    mNumSpans = numControls - degree;
+
+    int numKnots = numControls + degree + 1;
+    mKnots = mArena.Allocate<double>(numKnots);
+    for (int i = 0; i < numKnots; ++i)
+    {
+        if (i <= degree) mKnots[i] = 0.0;
+        else if (i >= numControls) mKnots[i] = 1.0;
+        else mKnots[i] = (double)(i - degree) / (double)(numControls - degree);
+    }
+
+    // Cox-de Boor recursion carried out on polynomials in u = (t - a)/delta,
+    // where [a, a + delta) is the span. basis[r] belongs to basis function
+    // span-degree+r and has degree+1 coefficients, lowest power first.
+    int order = degree + 1;
+    mCoeffs = mArena.Allocate<double>(mNumSpans * N * order);
+    std::fill(mCoeffs, mCoeffs + mNumSpans * N * order, 0.0);
+    double basis[MAX_DEGREE + 1][MAX_DEGREE + 1], previous[MAX_DEGREE + 1][MAX_DEGREE + 1];
+    for (int s = 0; s < mNumSpans; ++s)
+    {
+        int span = degree + s;
+        double a = mKnots[span], delta = mKnots[span + 1] - a;
+
+        for (int r = 0; r < order; ++r)
+            for (int k = 0; k < order; ++k) basis[r][k] = 0.0;
+        basis[0][0] = 1.0;
+        for (int p = 1; p <= degree; ++p)
+        {
+            for (int r = 0; r < p; ++r)
+                for (int k = 0; k < p; ++k) previous[r][k] = basis[r][k];
+            for (int r = 0; r <= p; ++r)
+            {
+                int i = span - p + r;
+                for (int k = 0; k <= p; ++k) basis[r][k] = 0.0;
+                // (t - k_i) / (k_{i+p} - k_i) * N_{i,p-1}
+                double d0 = mKnots[i + p] - mKnots[i];
+                if (r >= 1 && d0 > 0.0)
+                {
+                    double c0 = (a - mKnots[i]) / d0, c1 = delta / d0;
+                    for (int k = 0; k < p; ++k)
+                    {
+                        basis[r][k] += c0 * previous[r - 1][k];
+                        basis[r][k + 1] += c1 * previous[r - 1][k];
+                    }
+                }
+                // (k_{i+p+1} - t) / (k_{i+p+1} - k_{i+1}) * N_{i+1,p-1}
+                double d1 = mKnots[i + p + 1] - mKnots[i + 1];
+                if (r < p && d1 > 0.0)
+                {
+                    double c0 = (mKnots[i + p + 1] - a) / d1, c1 = -delta / d1;
+                    for (int k = 0; k < p; ++k)
+                    {
+                        basis[r][k] += c0 * previous[r][k];
+                        basis[r][k + 1] += c1 * previous[r][k];
+                    }
+                }
+            }
+        }
+
+        for (int j = 0; j < N; ++j)
+        {
+            double* coeffs = &mCoeffs[(s * N + j) * order];
+            for (int r = 0; r < order; ++r)
+            {
+                double control = controlData[(s + r) * N + j];
+                for (int k = 0; k < order; ++k) coeffs[k] += control * basis[r][k];
+            }
+        }
+    }
+}
+
+template <int N, typename Real>
+void BSplineBatchEvaluator<N, Real>::EvaluateUniform(unsigned int numSamples, Real multiplier, Real* positions)
+{
+    SplineArena::Scope scope(mArena);
+    double* u = mArena.Allocate<double>(numSamples);
+    double* value = mArena.Allocate<double>(numSamples);
+    int order = mDegree + 1;
+    unsigned int begin = 0;
+    for (int s = 0; s < mNumSpans && begin < numSamples; ++s)
+    {
+        // Samples [begin, end) fall into this span; the last span is closed.
+        unsigned int end = numSamples;
+        if (s + 1 < mNumSpans)
+        {
+            double knot = mKnots[mDegree + s + 1];
+            end = begin;
+            while (end < numSamples && (double)(multiplier * end) < knot) ++end;
+        }
+        unsigned int count = end - begin;
+        if (count == 0) continue;
+
+        double a = mKnots[mDegree + s];
+        double invDelta = 1.0 / (mKnots[mDegree + s + 1] - a);
+        for (unsigned int i = 0; i < count; ++i)
+            u[i] = ((double)(multiplier * (begin + i)) - a) * invDelta;
+
+        for (int j = 0; j < N; ++j)
+        {
+            double const* coeffs = &mCoeffs[(s * N + j) * order];
+            for (unsigned int i = 0; i < count; ++i) value[i] = coeffs[mDegree];
+            for (int k = mDegree - 1; k >= 0; --k)
+            {
+                double c = coeffs[k];
+                for (unsigned int i = 0; i < count; ++i) value[i] = value[i] * u[i] + c;
+            }
+            Real* out = positions + N * begin + j;
+            for (unsigned int i = 0; i < count; ++i) out[N * i] = (Real)value[i];
+        }
+        begin = end;
+    }
+}
+
+template <int N, typename Real>
+void BSplineBatchEvaluator<N, Real>::Evaluate(double t, Real* position) const
+{
+    // Interior knots are uniform, so the span is found directly; the last
+    // span is closed like in EvaluateUniform().
+    int s = std::min(std::max((int)(t * mNumSpans), 0), mNumSpans - 1);
+    while (s > 0 && t < mKnots[mDegree + s]) --s;
+    while (s + 1 < mNumSpans && t >= mKnots[mDegree + s + 1]) ++s;
+
+    int order = mDegree + 1;
+    double a = mKnots[mDegree + s];
+    double u = (t - a) / (mKnots[mDegree + s + 1] - a);
+    for (int j = 0; j < N; ++j)
+    {
+        double const* coeffs = &mCoeffs[(s * N + j) * order];
+        double value = coeffs[mDegree];
+        for (int k = mDegree - 1; k >= 0; --k) value = value * u + coeffs[k];
+        position[j] = (Real)value;
+    }
+}
+
+template class BSplineBatchEvaluator<3, float>;
+template class BSplineBatchEvaluator<3, double>;
@@ -1,548 +1,1352 @@
-// David Eberly, Geometric Tools, Redmond WA 98052
-// Copyright (c) 1998-2020
-// Distributed under the Boost Software License, Version 1.0.
-// https://www.boost.org/LICENSE_1_0.txt
-// https://www.geometrictools.com/License/Boost/LICENSE_1_0.txt
-// Version: 4.0.2019.08.13
-
-#include "BSplineCurveFitterWindow3.h"
-#include <Graphics/VertexColorEffect.h>
-#include <random>
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <stdlib.h>     /* srand, rand */
-#include <time.h>       /* time */
- 
-using namespace std;
-#define mDimension 3
-
-float *smd_ = nullptr;
-int TotalControlNum, width_, TotalTriple; 
-int DeterminedNumControls, DeterminedDegree;
-float minError;
-float minErrorThreshold;
-float storevector[mDimension]={0,0,0};
-vector<vector<vector<Vector3<float>>>> BSplineCurveFitterWindow3::IndexingCP = {{}};
-vector<vector<vector<Vector3<float>>>> BSplineCurveFitterWindow3::IndexingCP_Interactive = {{}};
-
-vector<Vector3<float>> ReadingSampleforEachCC = {{}};
-vector<Vector3<float>> ReadingSampleforEachInty = {{}};
-vector<vector<Vector3<float>>> CPforEachLayer_or_CC = {{}};
-
-unique_ptr<BSplineCurveGenerate<float>> SplineGeneratePtr;
-//bool mergeOrNot = true;   
-bool deleteshort = false;
-unsigned int MinAllowableLength = 4;
-float diagonal= 0.0f;
-
-BSplineCurveFitterWindow3::BSplineCurveFitterWindow3()
-{
-    //cout<<"BSplineCurveFitterWindow-----"<<endl;
-}
-int BSplineCurveFitterWindow3::SplineFit(vector<vector<Vector3<float>>> BranchSet, float hausdorff_,float diagonal_, int layerNum, vector<int *> connection_)
-{
-    TotalControlNum = 0;
-    if(!sampleSet.empty()) sampleSet.clear();
-    sampleSet = BranchSet;
-    minErrorThreshold = hausdorff_;
-    diagonal = diagonal_;
-    connection = connection_;
-    bool mergeOrNot = false; 
-    if (mergeOrNot) {Merge();}
-
-    for (unsigned int i = 0; i < sampleSet.size();i++)
-    {
-        if (sampleSet[i].size()>3) 
-            CalculateNeededCP(sampleSet[i]);
-    }
-     
-    return TotalControlNum; 
-}
-
-int BSplineCurveFitterWindow3::SplineFit2(vector<vector<Vector3<float>>> BranchSet, float hausdorff_,
-float diagonal_, int width, vector<int *> connection_, bool mergeOrNot, float *smd)
-{
-    TotalTriple = 0;
-    if(!sampleSet.empty()) sampleSet.clear();
-    sampleSet = BranchSet;
-    minErrorThreshold = hausdorff_;
-    diagonal = diagonal_;
-    connection = connection_; 
-    width_ = width;
-    smd_ = smd;
-    
-    if (mergeOrNot) { Merge();}
-    if(!CPforEachLayer_or_CC.empty()) CPforEachLayer_or_CC.clear();
-
-    for (unsigned int i = 0; i < sampleSet.size();i++)
-    {
-        if (sampleSet[i].size()>3) {
-            CreateBSplinePolyline(sampleSet[i]);
-        }
-    }
-    IndexingCP_Interactive.push_back(CPforEachLayer_or_CC);
-    smd_= nullptr;
-    return TotalTriple;
-    //cout<<"TotalTriple: "<<TotalTriple<<endl;
-}
-
-void BSplineCurveFitterWindow3::indexingSpline(vector<vector<Vector3<float>>> BranchSet, float hausdorff_,float diagonal_, int layerNum, int index)
-{
-    if(BranchSet.empty()){
-        vector<vector<Vector3<float>>> empty_vector;
-        //cout<<"empty_vector: "<<empty_vector.empty()<<endl;
-        IndexingCP.push_back(empty_vector);
-    }
-    else{
-        if(!sampleSet.empty()) sampleSet.clear();
-        sampleSet = BranchSet;
-        minErrorThreshold = hausdorff_;
-        diagonal = diagonal_;
-        
-        if(!CPforEachLayer_or_CC.empty()) CPforEachLayer_or_CC.clear();
-
-        for (unsigned int i = 0; i < sampleSet.size();i++)
-        {
-            if (sampleSet[i].size()>3){
-                CreateBSplinePolyline(sampleSet[i]);
-            }     
-        }
-        IndexingCP.push_back(CPforEachLayer_or_CC);
-        
-    }
-    //cout<<"IndexingCP.size(): "<<IndexingCP.size()<<endl;
-}
-
-vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::SplineGenerate()
-{
-    int CPnum,degree;
-    unsigned int numSamples;
-    vector<float> mControlData;
-
-    vector<vector<Vector3<float>>> ReadingCPforEachInty, ReadingSampleforAllInty;
-    vector<Vector3<float>> ReadingCPforEachBranch;
-    Vector3<float> ReadingEachCP;
-     
-    for(auto it = IndexingCP_Interactive.begin();it!=IndexingCP_Interactive.end();it++){
-        ReadingCPforEachInty = *it;
-        //cout<<"ReadingCPforEachInty size "<<ReadingCPforEachInty.size()<<endl;
-        for(auto it_ = ReadingCPforEachInty.begin();it_!=ReadingCPforEachInty.end();it_++){
-            ReadingCPforEachBranch = *it_;
-            bool first = true;
-            for(auto it_branch = ReadingCPforEachBranch.begin(); it_branch != ReadingCPforEachBranch.end(); it_branch++){
-                ReadingEachCP = *it_branch;
-                if(first){
-                    first = false;
-                    CPnum = ReadingEachCP[0];
-                    degree = ReadingEachCP[1];
-                    numSamples = ReadingEachCP[2];
-                }
-                else{
-                    for (int j = 0; j < mDimension; ++j)
-                    {
-                        mControlData.push_back(ReadingEachCP[j]/diagonal);
-                    }
-                }
-            }
-            //cout<<endl;
-            SplineGeneratePtr = std::make_unique<BSplineCurveGenerate<float>>(mDimension, degree, mControlData, CPnum);
-            
-            CreateGraphics(numSamples, 0);
-            mControlData.clear(); 
-
-        }
-        ReadingSampleforAllInty.push_back(ReadingSampleforEachInty);
-        ReadingSampleforEachInty.clear();
-    }
-    return ReadingSampleforAllInty;   
-}
-
-
-vector<Vector3<float>> BSplineCurveFitterWindow3::ReadIndexingSpline(vector<vector<Vector3<float>>> cpList)
-{
-    int CPnum,degree;
-    unsigned int numSamples;
-    vector<float> mControlData;
-
-    vector<Vector3<float>> ReadingCPforEachBranch;
-    Vector3<float> ReadingEachCP;
-    if(!ReadingSampleforEachCC.empty()) ReadingSampleforEachCC.clear();
-    
-    for(auto it_ = cpList.begin();it_!=cpList.end();it_++){
-        if(!(*it_).empty()){
-            ReadingCPforEachBranch = *it_;
-            bool first = true;
-            for(auto it_branch = ReadingCPforEachBranch.begin(); it_branch != ReadingCPforEachBranch.end(); it_branch++){
-                ReadingEachCP = *it_branch;
-                if(first){
-                    first = false;
-                    CPnum = ReadingEachCP[0];
-                    degree = ReadingEachCP[1];
-                    numSamples = ReadingEachCP[2];
-                }
-                else{
-                    if(CPnum > 1){
-                        for (int j = 0; j < mDimension; ++j)
-                        {
-                            mControlData.push_back(ReadingEachCP[j]/diagonal);
-                        }
-                    }
-                }
-            }
-
-            if(CPnum == 1)
-                ReadingSampleforEachCC.push_back(ReadingEachCP);
-            else{
-                SplineGeneratePtr = std::make_unique<BSplineCurveGenerate<float>>(mDimension, degree, mControlData, CPnum);
-                CreateGraphics(numSamples, 1);
-                mControlData.clear();
-            }  
-        }
-    }
-        
-    return ReadingSampleforEachCC;   
-}
-
-vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::ReadIndexingSpline()
-{
-    int CPnum,degree;
-    unsigned int numSamples;
-    //OutFile.open("sample.txt");
-    vector<float> mControlData;
-
-    vector<vector<Vector3<float>>> ReadingCPforEachCC, ReadingSampleforAllCC;
-    vector<Vector3<float>> ReadingCPforEachBranch;
-    Vector3<float> ReadingEachCP;
-    if(!ReadingSampleforEachCC.empty()) ReadingSampleforEachCC.clear();
-    
-    
-    for(auto it = IndexingCP.begin();it!=IndexingCP.end();it++){
-        //cout<<"(*it).empty(): "<<(*it).empty()<<endl;
-        if((*it).empty()){
-            vector<Vector3<float>> empty_sample;
-            ReadingSampleforAllCC.push_back(empty_sample);
-        }
-        else{
-            ReadingCPforEachCC = *it;
-            for(auto it_ = ReadingCPforEachCC.begin();it_!=ReadingCPforEachCC.end();it_++){
-                ReadingCPforEachBranch = *it_;
-                bool first = true;
-                for(auto it_branch = ReadingCPforEachBranch.begin(); it_branch != ReadingCPforEachBranch.end(); it_branch++){
-                    ReadingEachCP = *it_branch;
-                    if(first){
-                        first = false;
-                        CPnum = ReadingEachCP[0];
-                        degree = ReadingEachCP[1];
-                        numSamples = ReadingEachCP[2];
-                    }
-                    else{
-                        for (int j = 0; j < mDimension; ++j)
-                        {
-                            mControlData.push_back(ReadingEachCP[j]/diagonal);
-                        }
-
-                    }
-                }
-                SplineGeneratePtr = std::make_unique<BSplineCurveGenerate<float>>(mDimension, degree, mControlData, CPnum);
-            
-                CreateGraphics(numSamples, 1);
-                mControlData.clear(); 
-
-            }
-            //OutFile << 65535 <<endl;
-            ReadingSampleforAllCC.push_back(ReadingSampleforEachCC);
-            ReadingSampleforEachCC.clear();
-        }
-        
-    }
-
-    return ReadingSampleforAllCC;        
-    
-}
-
-
-void BSplineCurveFitterWindow3::CreateGraphics(unsigned int numSamples, int which)
-{
-    
-    unsigned int numSplineSample = (unsigned int)(numSamples*1.1);//sub-pixel.
-   // unsigned int numSplineSample = numSamples; //uniform sampling
-    float vector[mDimension]={0,0,0};
-    float multiplier = 1.0f / (numSplineSample - 1.0f);
-    Vector3<float> EachSample;
-
-    for (unsigned int i = 0; i < numSplineSample; ++i)
-    { 
-        float t = multiplier * i;
-       
-        SplineGeneratePtr->GetPosition(t, reinterpret_cast<float*>(vector));
-        //OutFile<<(int)(vector[0]*diagonal)<<" "<<(int)(vector[1]*diagonal)<<" "<<(int)(vector[2]*diagonal)<<endl;      //save to the txt file.
-        
-        for (int j = 0; j < mDimension; ++j)
-            EachSample[j] = (int)(vector[j]*diagonal);
-        
-        if(which) ReadingSampleforEachCC.push_back(EachSample);
-        else ReadingSampleforEachInty.push_back(EachSample);
-        
-    }
-}
-
-float BSplineCurveFitterWindow3::Judge(vector<Vector3<float>> Sample)
-{
-    unsigned int numSamples = (unsigned int)Sample.size();
-    vector<Vector3<float>> SplineSamples(10000);
-    
-    float CPandError = 0;
-    float factor = 1.0;
-    
-    unsigned int numSplineSamples = (unsigned int)(numSamples * 1.4);
-    //unsigned int numSplineSamples = numSamples; // uniform sampling.
-    float multiplier = 1.0f / (numSplineSamples - 1.0f);
-    SplineSamples.resize(numSplineSamples);
-    
-    int minDegree;
-    int numControls = 2;
-   // int iter = 0;
-    while (1)
-    {
-        //iter ++;
-        minError = 100.0f; minDegree = 10;
-        for (int degree = 1; degree < numControls; degree++)
-        {
-            if (degree > 10) break;
-            mSpline = std::make_unique<BSplineCurveFit<float>>(mDimension, static_cast<int>(Sample.size()),
-            reinterpret_cast<float const*>(&Sample[0]), degree, numControls);
-
-            for (unsigned int i = 0; i < numSplineSamples; ++i)
-            {
-                float t = multiplier * i;
-                mSpline->GetPosition(t, reinterpret_cast<float*>(storevector));
-                 for(int y=0;y<mDimension;y++)
-                    SplineSamples[i][y] = storevector[y];
-            }
-            
-        // Compute error measurements.
-            float maxLength = 0.0f;
-            Vector3<float> diff;
-            float sqrLength, minLength;
-            float weight = 0.0;
-            for (unsigned int i = 0; i < numSamples; ++i)
-            {
-                minLength = 100.0f;
-                for (unsigned int j = 0; j < numSplineSamples; ++j)
-                {
-                    diff = Sample[i] - SplineSamples[j];
-                    sqrLength = Dot(diff, diff);
-                    if (sqrLength < minLength) {minLength = sqrLength; if (minLength == 0) break;}
-                }
-                if (minLength > maxLength) maxLength = minLength;
-                
-                if(smd_!= nullptr){
-                    int index = (int)(Sample[i][1]*diagonal) * width_ + (int)(Sample[i][0]*diagonal);
-                    //cout<<Sample[i][0]<<"/ "<<Sample[i][1]<<" ";
-                    weight += pow(2.0, (smd_[index]/255.0 - 1.0));//from 1/3 to 3
-                }
-            }
-            if(smd_!= nullptr) factor = weight/(float)numSamples; //saliency factor
-            hausdorff = std::sqrt(maxLength);
-            if (minError > hausdorff) { minError = hausdorff; minDegree = degree;}
-            //cout<<numControls<<" hausdorff: "<<hausdorff<<" degree: "<<degree<<endl;
-        }
-        //cout<<numControls<<" minError: "<<minError<<" minDegree: "<<minDegree<<endl;
-        if (numControls > 15) 
-        {
-            CPandError = 100;//assign an big enough value
-            return CPandError;
-        }
-        if (minError < (minErrorThreshold/factor))
-        {
-            DeterminedNumControls = numControls;
-            DeterminedDegree = minDegree;
-            //cout<<" minError: "<<minError<<endl;
-            CPandError = numControls + minError;
-
-            break;
-        }
-        else numControls ++;
-    }
-   
-    return CPandError;
-}
-
-void BSplineCurveFitterWindow3::CalculateNeededCP(vector<Vector3<float>> Sample)
-{
-    float cpError = Judge(Sample);
-    
-    if (cpError == (float)100) //the branch may be too long to fit well.
-    {
-        vector<Vector3<float>> first = Sample;//init to VOID segmentation fault.
-        vector<Vector3<float>> second = Sample;
-        
-        for (unsigned int i = Sample.size()/2; i < Sample.size(); ++i) //split in the half
-            first[i] = 0;
-        first.resize(Sample.size()/2);  
-        for (unsigned int i = Sample.size()/2; i < Sample.size(); ++i)
-            second[i - Sample.size()/2] = Sample[i];
-        second.resize(Sample.size() - Sample.size()/2);  
-   
-        CalculateNeededCP(first);
-        CalculateNeededCP(second);
-    }
-    else 
-        TotalControlNum += DeterminedNumControls;
-}
-
-void BSplineCurveFitterWindow3::CreateBSplinePolyline(vector<Vector3<float>> Sample)
-{
-    float cpError = Judge(Sample);
-    
-    if (cpError == (float)100) //the branch may be too long to fit well.
-    {
-        cout<<"---------"<<endl;
-        vector<Vector3<float>> first = Sample;//init to VOID segmentation fault.
-        vector<Vector3<float>> second = Sample;
-        
-        for (unsigned int i = Sample.size()/2; i < Sample.size(); ++i) //split in the half
-            first[i] = 0;
-        first.resize(Sample.size()/2);  
-        for (unsigned int i = Sample.size()/2; i < Sample.size(); ++i)
-            second[i - Sample.size()/2] = Sample[i];
-        second.resize(Sample.size() - Sample.size()/2);  
-   
-        CreateBSplinePolyline(first);
-        CreateBSplinePolyline(second);
-    }
-    else
-    {                      
-        mSpline = std::make_unique<BSplineCurveFit<float>>(mDimension, static_cast<int>(Sample.size()),
-            reinterpret_cast<float const*>(&Sample[0]), DeterminedDegree, DeterminedNumControls);
-    
-        //cout<< DeterminedNumControls <<" "<<DeterminedDegree<<" "; 
-        //cout<< Sample.size() <<" "; 
-        vector<Vector3<float>> CPforEachBranch; 
-        Vector3<float> eachTriple;
-        eachTriple[0] = DeterminedNumControls;
-        eachTriple[1] = DeterminedDegree;
-        eachTriple[2] = Sample.size();
-        CPforEachBranch.push_back(eachTriple);
-        
-        
-        float const* controlDataPtr = mSpline->GetControlData();
-        for (int i = 0; i< DeterminedNumControls; ++i)
-        {
-            for (int j = 0; j < mDimension; ++j)
-            {
-                //controlData[i][j] = (*controlDataPtr);
-                //cout<<(round)(*controlDataPtr*diagonal)<<" ";
-                eachTriple[j] = (round)(*controlDataPtr*diagonal);
-                controlDataPtr++;
-            }
-            CPforEachBranch.push_back(eachTriple);
-        
-        }    
-        //cout<<"CPforEachLayer_or_CC.size "<<CPforEachLayer_or_CC.size()<<endl;
-        CPforEachLayer_or_CC.push_back(CPforEachBranch);
-        TotalTriple += (DeterminedNumControls+1);
-    }
-}
-
-void BSplineCurveFitterWindow3::Merge()
-{
-    vector<Vector3<float>> first, second;
-    float minEandContlNum = 100.0;
-    //float maxdiff = 0.0;
-    int minIndex = 1000;
-    float firstE,secondE,mergeE;
-    
-    //vector<int> GapFill;////
-    //outMerge.open("outMerge.txt");
-  //time:0.007
-    //clock_t start = clock();
-    for(auto it = connection.begin();it!=connection.end();it++)
-    {
-        int *sampleIndex = *it;
-        //cout<<out[0]<<"--"<<out[1]<<"--"<<out[2]<<"--"<<out[3]<<endl;
-        first = sampleSet[sampleIndex[0]];
-        if (deleteshort) firstE = Judge(first);
-        else 
-        {
-            if (first.size()<MinAllowableLength) firstE = 2.01;//
-            else firstE = Judge(first);
-        }
-
-        for(int index = 1; index < 4; index++)//index for 'sampleIndex'.
-        {
-            if(sampleIndex[index]==0) continue;
-            second = sampleSet[sampleIndex[index]];
-                
-            if (deleteshort) secondE = Judge(second);
-            else 
-            {
-                if(second.size()<MinAllowableLength) secondE = 2.01;//assign a big num.
-                else secondE = Judge(second);
-            }
-
-            merge.resize(10000);//very important!!
-            for (unsigned int i = 0; i < first.size(); ++i)
-                merge[i] = first[i];
-            
-            for (unsigned int i = first.size(); i < (first.size()+second.size()); ++i)
-                merge[i] = second[i-first.size()];
-                
-            merge.resize(first.size()+second.size());
-           
-
-            if (deleteshort) mergeE = Judge(merge);
-            else
-            {
-                if (merge.size()<MinAllowableLength) mergeE = 4; //about 3CP + 0.- error.
-                else mergeE = Judge(merge);
-            }
-    
-            //cout<<"mergeE: "<<mergeE<<" firstE: "<<firstE<<" secondE: "<<secondE<<endl;
-            if (mergeE < (firstE + secondE)) 
-                if (minEandContlNum > mergeE) { minEandContlNum = mergeE; minIndex = sampleIndex[index];}
-            
-        }
-        if (minIndex!=1000) //meet the merge condition.
-        {
-            //cout<<"Merge！ first: "<<sampleIndex[0]<<" second: "<<minIndex<<endl;
-            second = sampleSet[minIndex];
-            merge.resize(10000);//This is very important!!
-            for (unsigned int i = 0; i < first.size(); ++i)
-                merge[i] = first[i];
-            
-            for (unsigned int i = first.size(); i < (first.size()+second.size()); ++i)
-                merge[i] = second[i-first.size()];
-            merge.resize(first.size()+second.size());
-
-            //for (unsigned int i = 0; i<merge.size(); i++)
-            //    outMerge<<iter<<" "<<merge[i][0]*diagonal<<" "<<merge[i][1]*diagonal<<" "<<merge[i][2]*diagonal<<endl;
-        
-
-            sampleSet.erase(sampleSet.begin()+sampleIndex[0]);
-            sampleSet.insert(sampleSet.begin()+sampleIndex[0],merge);
-            //sampleSet.erase(sampleSet.begin()+minIndex);
-            sampleSet[minIndex].clear();//still occupy the position.
-
-            minEandContlNum = 100.0f;
-            minIndex = 1000;
-        }
-        
-    }
-    
-    //cout<<"--"<<sampleSet.size()<<endl;
-        for (unsigned int i = sampleSet.size()-1; i > 0;i--)
-        {
-            if (sampleSet[i].size()<1) 
-                sampleSet.erase(sampleSet.begin()+i);//when merged two branches, we'll leave one branch empty, 
-            //cout<<"--"<<i<<endl;                   //so we squeeze the vector, that' why we start from the end.
-
-        }
-        
-    
-
-    //outMerge.close();
-    //cout<<"--"<<sampleSet.size()<<endl;
-     
-}
+// David Eberly, Geometric Tools, Redmond WA 98052
+// Copyright (c) 1998-2020
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+// https://www.geometrictools.com/License/Boost/LICENSE_1_0.txt
+// Version: 4.0.2019.08.13
+
+#include "BSplineCurveFitterWindow3.h"
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdlib.h>     /* srand, rand */
+#include <time.h>       /* time */
+#include <algorithm>
+#include <limits>
+ 
+using namespace std;
+
+//bool mergeOrNot = true;   
+static const bool deleteshort = false;
+static const unsigned int MinAllowableLength = 4;
+
+BSplineCurveFitterWindow3::BSplineCurveFitterWindow3()
+    :
+    mSingle(mArena),
+    mDouble(mArena),
+    mGenerate(mArena),
+    mGenerateDouble(mArena),
+    mRasterizer(mArena)
+{
+    IndexingCP_Interactive.Append(vector<vector<Vector3<float>>>()); //starts with one empty layer.
+    //cout<<"BSplineCurveFitterWindow-----"<<endl;
+}
+int BSplineCurveFitterWindow3::SplineFit(vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,float diagonal_, int layerNum, vector<int *> const& connection_)
+{
+    TotalControlNum = 0;
+    fitStats = SplineFitStats();
+    mArena.Reset();
+    minErrorThreshold = hausdorff_;
+    diagonal = diagonal_;
+    connection = connection_;
+
+    FitBranches(BranchSet, true);
+     
+    return TotalControlNum; 
+}
+
+int BSplineCurveFitterWindow3::SplineFit2(vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,
+float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd)
+{
+    if (!mergeOrNot)
+        return FitLayer(BranchSet, hausdorff_, diagonal_, width, connection_, false, smd, NEW_LAYER);
+    sampleSet = BranchSet; //Merge() rewrites its own copy.
+    return FitLayer(sampleSet, hausdorff_, diagonal_, width, connection_, true, smd, NEW_LAYER);
+}
+
+int BSplineCurveFitterWindow3::SplineFit2(vector<vector<Vector3<float>>>&& BranchSet, float hausdorff_,
+float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd)
+{
+    sampleSet = std::move(BranchSet);
+    return FitLayer(sampleSet, hausdorff_, diagonal_, width, connection_, mergeOrNot, smd, NEW_LAYER);
+}
+
+int BSplineCurveFitterWindow3::UpdateLayer(unsigned int key, vector<vector<Vector3<float>>> const& BranchSet,
+float hausdorff_, float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd)
+{
+    if (!mergeOrNot)
+        return FitLayer(BranchSet, hausdorff_, diagonal_, width, connection_, false, smd, key);
+    sampleSet = BranchSet; //Merge() rewrites its own copy.
+    return FitLayer(sampleSet, hausdorff_, diagonal_, width, connection_, true, smd, key);
+}
+
+int BSplineCurveFitterWindow3::FitLayer(vector<vector<Vector3<float>>> const& branches, float hausdorff_,
+float diagonal_, int width, vector<int *> const& connection_, bool mergeOrNot, float *smd, unsigned int key)
+{
+    TotalTriple = 0;
+    fitStats = SplineFitStats();
+    mArena.Reset();
+    minErrorThreshold = hausdorff_;
+    diagonal = diagonal_;
+    connection = connection_; 
+    width_ = width;
+    smd_ = smd;
+    
+    if (mergeOrNot) { Merge();} //'branches' is sampleSet then.
+    if(!CPforEachLayer_or_CC.empty()) CPforEachLayer_or_CC.clear();
+
+    FitBranches(branches, false);
+    if (key == NEW_LAYER) lastLayerKey = IndexingCP_Interactive.Append(std::move(CPforEachLayer_or_CC));
+    else IndexingCP_Interactive.Put(lastLayerKey = key, std::move(CPforEachLayer_or_CC));
+    CPforEachLayer_or_CC.clear();
+    smd_= nullptr;
+    return TotalTriple;
+    //cout<<"TotalTriple: "<<TotalTriple<<endl;
+}
+
+void BSplineCurveFitterWindow3::indexingSpline(vector<vector<Vector3<float>>> const& BranchSet, float hausdorff_,float diagonal_, int layerNum, int index)
+{
+    fitStats = SplineFitStats();
+    mArena.Reset();
+    // Coarse levels keep one layer per IndexingCP layer, also for layers
+    // fitted before the levels were set.
+    if (IndexingCPLevels.size() < coarseScales.size())
+        IndexingCPLevels.resize(coarseScales.size(), vector<vector<vector<Vector3<float>>>>(IndexingCP.size()));
+    CPforEachLevel.assign(coarseScales.size(), vector<vector<Vector3<float>>>());
+    if(BranchSet.empty()){
+        vector<vector<Vector3<float>>> empty_vector;
+        //cout<<"empty_vector: "<<empty_vector.empty()<<endl;
+        IndexingCP.push_back(empty_vector);
+    }
+    else{
+        minErrorThreshold = hausdorff_;
+        diagonal = diagonal_;
+        
+        if(!CPforEachLayer_or_CC.empty()) CPforEachLayer_or_CC.clear();
+
+        levelsActive = !coarseScales.empty();
+        levelFits.resize(1 + coarseScales.size());
+        FitBranches(BranchSet, false);
+        levelsActive = false;
+        IndexingCP.push_back(std::move(CPforEachLayer_or_CC));
+        CPforEachLayer_or_CC.clear();
+        
+    }
+    for (unsigned int level = 0; level < IndexingCPLevels.size(); ++level)
+    {
+        if (level < CPforEachLevel.size()) IndexingCPLevels[level].push_back(std::move(CPforEachLevel[level]));
+        else IndexingCPLevels[level].push_back(vector<vector<Vector3<float>>>());
+    }
+    CPforEachLevel.clear();
+    //cout<<"IndexingCP.size(): "<<IndexingCP.size()<<endl;
+}
+
+void BSplineCurveFitterWindow3::set_coarseLevels(vector<float> const& scales)
+{
+    coarseScales.clear();
+    for (float scale : scales)
+        if (scale > 1.0f) coarseScales.push_back(scale);
+    std::sort(coarseScales.begin(), coarseScales.end());
+    coarseScales.erase(std::unique(coarseScales.begin(), coarseScales.end()), coarseScales.end());
+}
+
+void BSplineCurveFitterWindow3::BeginStream(float hausdorff_, float diagonal_, ControlBlockSink sink, int width, float *smd)
+{
+    TotalTriple = 0;
+    fitStats = SplineFitStats();
+    mArena.Reset();
+    minErrorThreshold = hausdorff_;
+    diagonal = diagonal_;
+    width_ = width;
+    smd_ = smd;
+    streamSink = std::move(sink);
+    CPforEachLayer_or_CC.clear();
+}
+
+int BSplineCurveFitterWindow3::FitBranch(Vector3<float> const* samples, size_t numSamples)
+{
+    if (numSamples <= 3) return 0; //too short to fit, as in FitBranches.
+    int previousTriple = TotalTriple;
+    SplineArena::Scope scope(mArena);
+    CreateBSplinePolyline(WeighBranch(SampleView(samples, (unsigned int)numSamples)));
+    if (streamSink)
+        for (auto const& block : CPforEachLayer_or_CC) streamSink(block);
+    CPforEachLayer_or_CC.clear();
+    return TotalTriple - previousTriple;
+}
+
+int BSplineCurveFitterWindow3::FitBranch(vector<Vector3<float>> const& branch)
+{
+    if (branch.empty()) return 0;
+    return FitBranch(&branch[0], branch.size());
+}
+
+int BSplineCurveFitterWindow3::EndStream()
+{
+    streamSink = nullptr;
+    smd_ = nullptr;
+    return TotalTriple;
+}
+
+SplineArena::Stats BSplineCurveFitterWindow3::get_arenaStats() const
+{
+    SplineArena::Stats stats = mArena.GetStats();
+    for (auto const& worker : mWorkers)
+    {
+        SplineArena::Stats const& other = worker->mArena.GetStats();
+        stats.heapAllocations += other.heapAllocations;
+        stats.allocations += other.allocations;
+        stats.reservedBytes += other.reservedBytes;
+        stats.peakBytes = std::max(stats.peakBytes, other.peakBytes);
+    }
+    return stats;
+}
+
+void BSplineCurveFitterWindow3::set_numThreads(unsigned int numThreads_)
+{
+    if (numThreads_ == 0) numThreads_ = thread::hardware_concurrency();
+    if (numThreads_ == 0) numThreads_ = 1;
+    if (numThreads_ == numThreads) return;
+    numThreads = numThreads_;
+    mPool.reset();
+    mWorkers.clear();
+}
+
+void BSplineCurveFitterWindow3::PrepareWorkers()
+{
+    if (!mPool)
+    {
+        mPool = std::make_unique<SplineThreadPool>(numThreads);
+        for (unsigned int i = 0; i < mPool->GetNumWorkers(); ++i)
+            mWorkers.push_back(std::make_unique<BSplineCurveFitterWindow3>());
+    }
+    for (auto& worker : mWorkers)
+    {
+        worker->minErrorThreshold = minErrorThreshold;
+        worker->diagonal = diagonal;
+        worker->smd_ = smd_;
+        worker->width_ = width_;
+        worker->controlSearch = controlSearch;
+        worker->pruneDegrees = pruneDegrees;
+        worker->fitEngine = fitEngine;
+        worker->precision = precision;
+        worker->saliencyWeighting = saliencyWeighting;
+        worker->coarseScales = coarseScales;
+        worker->levelsActive = levelsActive;
+        worker->levelFits.resize(levelFits.size());
+        worker->segmentation = segmentation;
+        worker->fitStats = SplineFitStats();
+        worker->mArena.Reset();
+    }
+}
+
+uint64_t BSplineCurveFitterWindow3::FitCacheContext(bool countOnly) const
+{
+    // Everything besides the samples and their saliency that a branch's fit
+    // depends on.
+    uint64_t context = SplineFitCache::Hash(&minErrorThreshold, sizeof(minErrorThreshold));
+    context = SplineFitCache::Hash(&diagonal, sizeof(diagonal), context);
+    int settings[] = { countOnly, levelsActive, smd_ != nullptr, (int)controlSearch, pruneDegrees,
+        (int)fitEngine, (int)segmentation, (int)saliencyWeighting, (int)precision };
+    context = SplineFitCache::Hash(settings, sizeof(settings), context);
+    if (levelsActive) context = SplineFitCache::Hash(coarseScales.data(), coarseScales.size() * sizeof(float), context);
+    return context;
+}
+
+uint64_t BSplineCurveFitterWindow3::BranchCacheContext(uint64_t context, vector<Vector3<float>> const& branch) const
+{
+    // The saliency under the samples, read as SaliencyWeight() does.
+    if (smd_ == nullptr) return context;
+    for (auto const& sample : branch)
+    {
+        float saliency = smd_[(int)(sample[1]*diagonal) * width_ + (int)(sample[0]*diagonal)];
+        context = SplineFitCache::Hash(&saliency, sizeof(saliency), context);
+    }
+    return context;
+}
+
+void BSplineCurveFitterWindow3::FitBranches(vector<vector<Vector3<float>>> const& branches, bool countOnly)
+{
+    uint64_t settings = fitCache.IsEnabled() ? FitCacheContext(countOnly) : 0;
+    if (numThreads <= 1)
+    {
+        for (unsigned int i = 0; i < branches.size();i++)
+        {
+            if (branches[i].size()>3) {
+                if (!fitCache.IsEnabled())
+                {
+                    SplineArena::Scope scope(mArena);
+                    FitOneBranch(WeighBranch(branches[i]), countOnly);
+                    continue;
+                }
+                uint64_t context = BranchCacheContext(settings, branches[i]);
+                SplineFitCache::Entry const* cached = fitCache.Find(context, branches[i].data(), branches[i].size());
+                if (cached)
+                {
+                    if (countOnly) TotalControlNum += cached->count;
+                    else
+                    {
+                        CPforEachLayer_or_CC.insert(CPforEachLayer_or_CC.end(), cached->blocks[0].begin(), cached->blocks[0].end());
+                        for (unsigned int level = 0; level < CPforEachLevel.size() && level + 1 < cached->blocks.size(); level++)
+                            CPforEachLevel[level].insert(CPforEachLevel[level].end(),
+                                cached->blocks[level + 1].begin(), cached->blocks[level + 1].end());
+                        TotalTriple += cached->count;
+                    }
+                    continue;
+                }
+
+                // Fit and keep a copy of what the branch appended.
+                size_t numBlocks = CPforEachLayer_or_CC.size();
+                vector<size_t> numLevelBlocks;
+                for (auto const& level : CPforEachLevel) numLevelBlocks.push_back(level.size());
+                int previous = countOnly ? TotalControlNum : TotalTriple;
+                {
+                    SplineArena::Scope scope(mArena);
+                    FitOneBranch(WeighBranch(branches[i]), countOnly);
+                }
+                SplineFitCache::Entry entry;
+                entry.count = (countOnly ? TotalControlNum : TotalTriple) - previous;
+                if (!countOnly)
+                {
+                    entry.blocks.emplace_back(CPforEachLayer_or_CC.begin() + numBlocks, CPforEachLayer_or_CC.end());
+                    for (unsigned int level = 0; level < CPforEachLevel.size(); level++)
+                        entry.blocks.emplace_back(CPforEachLevel[level].begin() + numLevelBlocks[level], CPforEachLevel[level].end());
+                }
+                fitCache.Insert(context, branches[i].data(), branches[i].size(), std::move(entry));
+            }
+        }
+        return;
+    }
+
+    // Longest branches first: they are the most expensive to fit, and the
+    // pool hands the short tail to whichever worker runs out of work. Cached
+    // branches are filled in here and not handed out.
+    vector<vector<vector<Vector3<float>>>> blocks(branches.size());
+    vector<vector<vector<vector<Vector3<float>>>>> levelBlocks(branches.size());
+    vector<int> counts(branches.size(), 0);
+    vector<uint64_t> contexts(fitCache.IsEnabled() ? branches.size() : 0);
+    vector<unsigned int> order;
+    for (unsigned int i = 0; i < branches.size(); i++)
+    {
+        if (branches[i].size()<=3) continue;
+        if (fitCache.IsEnabled())
+        {
+            contexts[i] = BranchCacheContext(settings, branches[i]);
+            SplineFitCache::Entry const* cached = fitCache.Find(contexts[i], branches[i].data(), branches[i].size());
+            if (cached)
+            {
+                counts[i] = cached->count;
+                if (!countOnly)
+                {
+                    blocks[i] = cached->blocks[0];
+                    levelBlocks[i].assign(cached->blocks.begin() + 1, cached->blocks.end());
+                }
+                continue;
+            }
+        }
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&branches](unsigned int a, unsigned int b)
+        { return branches[a].size() > branches[b].size(); });
+
+    PrepareWorkers();
+    mPool->Run(order, [&](unsigned int i, unsigned int w)
+    {
+        BSplineCurveFitterWindow3& worker = *mWorkers[w];
+        SplineArena::Scope scope(worker.mArena);
+        if (countOnly)
+        {
+            worker.TotalControlNum = 0;
+            worker.FitOneBranch(worker.WeighBranch(branches[i]), true);
+            counts[i] = worker.TotalControlNum;
+        }
+        else
+        {
+            worker.CPforEachLayer_or_CC.clear();
+            worker.CPforEachLevel.assign(CPforEachLevel.size(), vector<vector<Vector3<float>>>());
+            worker.TotalTriple = 0;
+            worker.FitOneBranch(worker.WeighBranch(branches[i]), false);
+            blocks[i].swap(worker.CPforEachLayer_or_CC);
+            levelBlocks[i].swap(worker.CPforEachLevel);
+            counts[i] = worker.TotalTriple;
+        }
+    });
+
+    for (auto& worker : mWorkers) fitStats.Add(worker->fitStats);
+
+    for (unsigned int i : order)
+    {
+        if (!fitCache.IsEnabled()) break;
+        SplineFitCache::Entry entry;
+        entry.count = counts[i];
+        if (!countOnly)
+        {
+            entry.blocks.push_back(blocks[i]);
+            entry.blocks.insert(entry.blocks.end(), levelBlocks[i].begin(), levelBlocks[i].end());
+        }
+        fitCache.Insert(contexts[i], branches[i].data(), branches[i].size(), std::move(entry));
+    }
+
+    // Put the results back in branch order, as the serial loop produces them.
+    for (unsigned int i = 0; i < branches.size(); i++)
+    {
+        if (countOnly) TotalControlNum += counts[i];
+        else
+        {
+            for (auto& block : blocks[i])
+                CPforEachLayer_or_CC.push_back(std::move(block));
+            for (unsigned int level = 0; level < levelBlocks[i].size(); level++)
+                for (auto& block : levelBlocks[i][level])
+                    CPforEachLevel[level].push_back(std::move(block));
+            TotalTriple += counts[i];
+        }
+    }
+}
+
+vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::SplineGenerate()
+{
+    // Clean layers come from the store's cache; the dirty ones are decoded
+    // together, so their blocks can be spread over the workers.
+    size_t numLayers = IndexingCP_Interactive.GetNumLayers();
+    vector<vector<Vector3<float>>> ReadingSampleforAllInty(numLayers);
+    vector<size_t> dirtyLayers;
+    vector<vector<vector<Vector3<float>>> const*> dirtyBlocks;
+    for(size_t layer = 0; layer < numLayers; layer++){
+        if (!IndexingCP_Interactive.IsDirty(layer))
+            ReadingSampleforAllInty[layer] = IndexingCP_Interactive.GetSamples(layer);
+        else
+        {
+            dirtyLayers.push_back(layer);
+            dirtyBlocks.push_back(&IndexingCP_Interactive.GetBlocks(layer));
+        }
+    }
+
+    // The first layer ever decoded starts with an initial sample. It is
+    // returned by that call only and kept out of the cached samples.
+    vector<vector<Vector3<float>>> decoded(dirtyLayers.size());
+    bool leading = !decoded.empty() && !ReadingSampleforEachInty.empty();
+    if (leading) decoded[0].swap(ReadingSampleforEachInty);
+    DecodeLayers(dirtyBlocks, decoded);
+    for (size_t i = 0; i < dirtyLayers.size(); i++)
+    {
+        ReadingSampleforAllInty[dirtyLayers[i]] = decoded[i];
+        if (i == 0 && leading) decoded[i].erase(decoded[i].begin());
+        IndexingCP_Interactive.SetSamples(dirtyLayers[i], std::move(decoded[i]));
+    }
+    return ReadingSampleforAllInty;   
+}
+
+
+vector<Vector3<float>> BSplineCurveFitterWindow3::ReadIndexingSpline(vector<vector<Vector3<float>>> const& cpList)
+{
+    int CPnum,degree;
+    unsigned int numSamples;
+    vector<float> mControlData;
+
+    Vector3<float> ReadingEachCP;
+    vector<Vector3<float>> ReadingSampleforEachCC;
+    
+    for(auto it_ = cpList.begin();it_!=cpList.end();it_++){
+        if(!(*it_).empty()){
+            vector<Vector3<float>> const& ReadingCPforEachBranch = *it_;
+            bool first = true;
+            for(auto it_branch = ReadingCPforEachBranch.begin(); it_branch != ReadingCPforEachBranch.end(); it_branch++){
+                ReadingEachCP = *it_branch;
+                if(first){
+                    first = false;
+                    CPnum = ReadingEachCP[0];
+                    degree = ReadingEachCP[1];
+                    numSamples = ReadingEachCP[2];
+                }
+                else{
+                    if(CPnum > 1){
+                        for (int j = 0; j < DIMENSION; ++j)
+                        {
+                            mControlData.push_back(ReadingEachCP[j]);
+                        }
+                    }
+                }
+            }
+
+            if(CPnum == 1)
+                ReadingSampleforEachCC.push_back(ReadingEachCP);
+            else{
+                AppendGraphics(degree, CPnum, &mControlData[0], numSamples, ReadingSampleforEachCC);
+                mControlData.clear();
+            }  
+        }
+    }
+        
+    return ReadingSampleforEachCC;   
+}
+
+vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::ReadIndexingSpline()
+{
+    return DecodeIndex(IndexingCP);
+}
+
+vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::ReadIndexingSpline(unsigned int level)
+{
+    vector<vector<vector<Vector3<float>>>> const* index = IndexLevel(level);
+    if (index == nullptr) return vector<vector<Vector3<float>>>();
+    return DecodeIndex(*index);
+}
+
+vector<vector<vector<Vector3<float>>>> const* BSplineCurveFitterWindow3::IndexLevel(unsigned int level) const
+{
+    if (level == 0) return &IndexingCP;
+    if (level > IndexingCPLevels.size()) return nullptr;
+    return &IndexingCPLevels[level - 1];
+}
+
+void BSplineCurveFitterWindow3::RasterizeIndexingSpline(PixelSink const& sink, unsigned int level)
+{
+    vector<vector<vector<Vector3<float>>>> const* index = IndexLevel(level);
+    if (index == nullptr) return;
+    SPLINE_TIMED(fitStats.reconstructionSeconds);
+    for (unsigned int layer = 0; layer < index->size(); layer++)
+    {
+        auto layerSink = [&sink, layer](int x, int y, int radius) { sink(layer, x, y, radius); };
+        for (auto const& block : (*index)[layer])
+            mRasterizer.Rasterize(block, layerSink);
+    }
+}
+
+bool BSplineCurveFitterWindow3::RasterizeIndexingSpline(unsigned int layer, unsigned char* mask, int width, int height,
+    unsigned int level)
+{
+    vector<vector<vector<Vector3<float>>>> const* index = IndexLevel(level);
+    if (index == nullptr || layer >= index->size()) return false;
+    SPLINE_TIMED(fitStats.reconstructionSeconds);
+    auto maskSink = [mask, width, height](int x, int y, int)
+    {
+        if (x >= 0 && y >= 0 && x < width && y < height) mask[y * width + x] = 1;
+    };
+    for (auto const& block : (*index)[layer])
+        mRasterizer.Rasterize(block, maskSink);
+    return true;
+}
+
+vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::DecodeIndex(vector<vector<vector<Vector3<float>>>> const& index)
+{
+    vector<vector<vector<Vector3<float>>> const*> layers;
+    for (auto const& layer : index) layers.push_back(&layer);
+    vector<vector<Vector3<float>>> ReadingSampleforAllCC(index.size());
+    DecodeLayers(layers, ReadingSampleforAllCC);
+    return ReadingSampleforAllCC;
+}
+
+void BSplineCurveFitterWindow3::DecodeLayers(vector<vector<vector<Vector3<float>>> const*> const& layers,
+    vector<vector<Vector3<float>>>& samples)
+{
+    // samples[l] holds whatever precedes the samples of layers[l]. A block's
+    // header fixes how many samples it decodes to, so every block is decoded
+    // straight into its place in the output: serially, or as one task per
+    // block on the workers, longest first. Either way the output is the same.
+    vector<vector<Vector3<float>> const*> blocks;
+    vector<Vector3<float>*> targets;
+    for (size_t layer = 0; layer < layers.size(); layer++)
+    {
+        size_t offset = samples[layer].size();
+        vector<size_t> offsets;
+        for (auto const& block : *layers[layer])
+        {
+            offsets.push_back(offset);
+            if (!block.empty()) offset += NumGraphicsSamples((unsigned int)block[0][2]);
+        }
+        samples[layer].resize(offset);
+        for (size_t b = 0; b < layers[layer]->size(); b++)
+        {
+            if ((*layers[layer])[b].empty()) continue;
+            blocks.push_back(&(*layers[layer])[b]);
+            targets.push_back(samples[layer].data() + offsets[b]);
+        }
+    }
+
+    if (numThreads <= 1 || blocks.size() < 2)
+    {
+        for (size_t i = 0; i < blocks.size(); i++) DecodeBlock(*blocks[i], targets[i]);
+        return;
+    }
+
+    vector<unsigned int> order(blocks.size());
+    for (unsigned int i = 0; i < blocks.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&blocks](unsigned int a, unsigned int b)
+        { return (*blocks[a])[0][2] > (*blocks[b])[0][2]; });
+    PrepareWorkers();
+    mPool->Run(order, [&](unsigned int i, unsigned int w)
+    {
+        mWorkers[w]->DecodeBlock(*blocks[i], targets[i]);
+    });
+    for (auto& worker : mWorkers) fitStats.Add(worker->fitStats);
+}
+
+void BSplineCurveFitterWindow3::DecodeBlock(vector<Vector3<float>> const& block, Vector3<float>* target)
+{
+    // [CPnum, degree, numSamples], then the control points in pixel units.
+    CreateGraphics((int)block[0][1], (int)block[0][0], reinterpret_cast<float const*>(&block[1]),
+        (unsigned int)block[0][2], target);
+}
+
+
+vector<Vector3<float>> BSplineCurveFitterWindow3::ReadIndexingSpline(SplineCPReader const& reader, size_t layer)
+{
+    SplineCPReader::Cursor cursor = reader.GetLayer(layer);
+    SplineCPBranch branch;
+    vector<float> points;
+    vector<Vector3<float>> ReadingSampleforEachCC;
+
+    while (cursor.Next(branch, points))
+    {
+        if (branch.numEntries == 0) continue;
+        if (branch.CPnum == 1)
+        {
+            Vector3<float> ReadingEachCP;
+            for (int j = 0; j < DIMENSION; ++j)
+                ReadingEachCP[j] = points[points.size() - DIMENSION + j];
+            ReadingSampleforEachCC.push_back(ReadingEachCP);
+        }
+        else AppendGraphics(branch.degree, branch.CPnum, &points[0], branch.numSamples, ReadingSampleforEachCC);
+    }
+    return ReadingSampleforEachCC;
+}
+
+vector<vector<Vector3<float>>> BSplineCurveFitterWindow3::ReadIndexingSpline(SplineCPReader const& reader)
+{
+    vector<vector<Vector3<float>>> ReadingSampleforAllCC;
+    for (size_t layer = 0; layer < reader.GetNumLayers(); ++layer)
+    {
+        ReadingSampleforAllCC.push_back(ReadIndexingSpline(reader, layer));
+    }
+    return ReadingSampleforAllCC;
+}
+
+unsigned int BSplineCurveFitterWindow3::NumGraphicsSamples(unsigned int numSamples)
+{
+    return (unsigned int)(numSamples*1.1);//sub-pixel.
+   // return numSamples; //uniform sampling
+}
+
+void BSplineCurveFitterWindow3::AppendGraphics(int degree, int numControls, float const* controlData,
+    unsigned int numSamples, vector<Vector3<float>>& target)
+{
+    size_t offset = target.size();
+    target.resize(offset + NumGraphicsSamples(numSamples));
+    CreateGraphics(degree, numControls, controlData, numSamples, target.data() + offset);
+}
+
+template <int N, typename Real>
+static void GenerateSamples(BSplineBatchEvaluator<N, Real>& generate, SplineArena& arena, int degree, int numControls,
+    Real const* controlData, unsigned int numSplineSample, Vector3<float>* target)
+{
+    Real multiplier = (Real)1 / (numSplineSample - (Real)1);
+    generate.SetControls(degree, numControls, controlData);
+    Real* GraphicsSamples = arena.Allocate<Real>(numSplineSample * N);
+    generate.EvaluateUniform(numSplineSample, multiplier, GraphicsSamples);
+
+    Real const* vector = GraphicsSamples;
+    for (unsigned int i = 0; i < numSplineSample; ++i)
+    { 
+        //OutFile<<(int)(vector[0]*diagonal)<<" "<<(int)(vector[1]*diagonal)<<" "<<(int)(vector[2]*diagonal)<<endl;      //save to the txt file.
+        for (int j = 0; j < N; ++j)
+            target[i][j] = (int)vector[j];
+        vector += N;
+    }
+}
+
+void BSplineCurveFitterWindow3::CreateGraphics(int degree, int numControls, float const* controlData,
+    unsigned int numSamples, Vector3<float>* target)
+{
+    
+    unsigned int numSplineSample = NumGraphicsSamples(numSamples);
+    SPLINE_TIMED(fitStats.reconstructionSeconds);
+    SplineArena::Scope scope(mArena);
+    if (precision == Precision::Double)
+    {
+        double* controls = mArena.Allocate<double>(numControls * DIMENSION);
+        std::copy(controlData, controlData + numControls * DIMENSION, controls);
+        GenerateSamples(mGenerateDouble, mArena, degree, numControls, controls, numSplineSample, target);
+    }
+    else GenerateSamples(mGenerate, mArena, degree, numControls, controlData, numSplineSample, target);
+}
+
+void BSplineCurveFitterWindow3::BindSamples(SampleView Sample)
+{
+    // Hand the samples of a Judge() and the weights SaliencyFactor() made
+    // for them to the engines of the current precision. The double copies
+    // live in the caller's arena scope.
+    unsigned int numSamples = Sample.size();
+    mSingle.samples = Sample.data();
+    mSingle.sqrWeights = sampleSqrWeights;
+    if (fitEngine != FitEngine::Incremental) return;
+    if (precision == Precision::Single)
+    {
+        mSingle.fit.SetSamples(Sample.data(), numSamples);
+        return;
+    }
+
+    Vector3<double>* samples = mArena.Allocate<Vector3<double>>(numSamples);
+    for (unsigned int i = 0; i < numSamples; ++i)
+        for (int j = 0; j < DIMENSION; ++j)
+            samples[i][j] = Sample[i][j];
+    double* sqrWeights = nullptr;
+    if (sampleSqrWeights)
+    {
+        sqrWeights = mArena.Allocate<double>(numSamples);
+        std::copy(sampleSqrWeights, sampleSqrWeights + numSamples, sqrWeights);
+    }
+    mDouble.samples = samples;
+    mDouble.sqrWeights = sqrWeights;
+    mDouble.fit.SetSamples(samples, numSamples);
+}
+
+float BSplineCurveFitterWindow3::JudgeControls(SampleView Sample, int numControls, int& minDegree, float bound)
+{
+    if (precision == Precision::Double && fitEngine == FitEngine::Incremental)
+        return JudgeControls(mDouble, Sample, numControls, minDegree, bound);
+    return JudgeControls(mSingle, Sample, numControls, minDegree, bound);
+}
+
+template <typename Real>
+float BSplineCurveFitterWindow3::JudgeControls(JudgeEngines<Real>& engines, SampleView Sample, int numControls,
+    int& minDegree, float bound)
+{
+    // Errors at or above 'bound' only matter as "too large" to the caller, so
+    // a candidate's error evaluation stops once it is proven to reach 'bound'
+    // or the best error so far. The error returned is exact whenever it is
+    // below 'bound'. In count-only mode the first degree below 'bound' ends
+    // the sweep and its control points are not kept.
+    unsigned int numSamples = (unsigned int)Sample.size();
+    unsigned int numSplineSamples = (unsigned int)(numSamples * 1.4);
+    //unsigned int numSplineSamples = numSamples; // uniform sampling.
+    Real multiplier = (Real)1 / (numSplineSamples - (Real)1);
+    SplineArena::Scope scope(mArena);
+    Vector3<Real>* SplineSamples = mArena.Allocate<Vector3<Real>>(numSplineSamples);
+
+    float previousError = 100.0f;
+    minError = 100.0f; minDegree = 10;
+    for (int degree = 1; degree < numControls; degree++)
+    {
+        if (degree > MAX_DEGREE) break;
+        SPLINE_STATS(fitStats.candidateFits++);
+        SplineArena::Scope candidate(mArena);
+        // The Reference engine only runs with the float engines.
+        float const* referenceData = nullptr;
+        Real const* controlData = nullptr;
+        {
+            SPLINE_TIMED(fitStats.fitSeconds);
+            if (fitEngine == FitEngine::Reference)
+            {
+                mSpline = std::make_unique<BSplineCurveFit<float>>(DIMENSION, static_cast<int>(Sample.size()),
+                reinterpret_cast<float const*>(Sample.data()), degree, numControls);
+                referenceData = mSpline->GetControlData();
+            }
+            else
+            {
+                if (!engines.fit.Fit(degree, numControls)) continue; //fewer samples than control points.
+                controlData = engines.fit.GetControlData();
+            }
+        }
+
+        {
+            SPLINE_TIMED(fitStats.reconstructionSeconds);
+            if (fitEngine == FitEngine::Reference)
+            {
+                for (unsigned int i = 0; i < numSplineSamples; ++i)
+                {
+                    float t = (float)(multiplier * i);
+                    mSpline->GetPosition(t, reinterpret_cast<float*>(storevector));
+                     for(int y=0;y<DIMENSION;y++)
+                        SplineSamples[i][y] = storevector[y];
+                }
+            }
+            else
+            {
+                engines.evaluate.SetControls(degree, numControls, controlData);
+                engines.evaluate.EvaluateUniform(numSplineSamples, multiplier, reinterpret_cast<Real*>(SplineSamples));
+            }
+        }
+
+    // Compute error measurements.
+        Real maxLength;
+        {
+            SPLINE_TIMED(fitStats.errorSeconds);
+            SPLINE_STATS(unsigned long numDistances = engines.hausdorff.GetNumDistances());
+            engines.hausdorff.Build(SplineSamples, numSplineSamples);
+            // Degree pruning compares consecutive errors, so it needs them exact.
+            Real errorBound = pruneDegrees ? std::numeric_limits<Real>::infinity() : (Real)std::min(minError, bound);
+            maxLength = engines.hausdorff.MaxSquaredDistance(engines.samples, numSamples, (Real)100, engines.sqrWeights, errorBound);
+            SPLINE_STATS(fitStats.distanceEvaluations += engines.hausdorff.GetNumDistances() - numDistances);
+        }
+        hausdorff = (float)std::sqrt(maxLength);
+        if (minError > hausdorff)
+        {
+            minError = hausdorff; minDegree = degree;
+            if (!countOnlyMode && referenceData)
+                std::copy(referenceData, referenceData + numControls * DIMENSION, roundControlData.begin());
+            else if (!countOnlyMode)
+                std::copy(controlData, controlData + numControls * DIMENSION, roundControlData.begin());
+        }
+        if (countOnlyMode && hausdorff < bound) break;
+        //cout<<numControls<<" hausdorff: "<<hausdorff<<" degree: "<<degree<<endl;
+
+        // Higher degrees rarely win once the error stopped decreasing.
+        if (pruneDegrees && hausdorff >= previousError) break;
+        previousError = hausdorff;
+    }
+    //cout<<numControls<<" minError: "<<minError<<" minDegree: "<<minDegree<<endl;
+    return minError;
+}
+
+double BSplineCurveFitterWindow3::SaliencyWeight(Vector3<float> const& sample) const
+{
+    // pow(2, s/255 - 1) for every 8-bit saliency value s, built once.
+    static array<double, 256> const table = []()
+    {
+        array<double, 256> values;
+        for (int i = 0; i < 256; ++i) values[i] = pow(2.0, (i/255.0 - 1.0));
+        return values;
+    }();
+
+    int index = (int)(sample[1]*diagonal) * width_ + (int)(sample[0]*diagonal);
+    float saliency = smd_[index];
+    if (saliency >= 0.0f && saliency <= 255.0f && saliency == (float)(int)saliency)
+        return table[(int)saliency];
+    return pow(2.0, (saliency/255.0 - 1.0));//from 1/3 to 3
+}
+
+BSplineCurveFitterWindow3::SampleView BSplineCurveFitterWindow3::WeighBranch(SampleView branch)
+{
+    // One weight per sample, shared by every Judge() on the branch and on
+    // the pieces it is split into. Lives in the caller's arena scope.
+    if (smd_ == nullptr) return branch;
+    double* weights = mArena.Allocate<double>(branch.size());
+    for (unsigned int i = 0; i < branch.size(); ++i)
+        weights[i] = SaliencyWeight(branch[i]);
+    return SampleView(branch.data(), branch.size(), weights);
+}
+
+float BSplineCurveFitterWindow3::SaliencyFactor(SampleView Sample)
+{
+    // The threshold is divided by the returned factor. PerSample weighting
+    // leaves it alone and hands JudgeControls the squared sample weights,
+    // allocated in the caller's arena scope.
+    unsigned int numSamples = Sample.size();
+    float factor = 1.0;
+    sampleSqrWeights = nullptr;
+    if(smd_!= nullptr && saliencyWeighting == SaliencyWeighting::PerSample){
+        float* sqrWeights = mArena.Allocate<float>(numSamples);
+        for (unsigned int i = 0; i < numSamples; ++i)
+        {
+            double w = Sample.weights() ? Sample.weights()[i] : SaliencyWeight(Sample[i]);
+            sqrWeights[i] = (float)(w * w);
+        }
+        sampleSqrWeights = sqrWeights;
+    }
+    else if(smd_!= nullptr){
+        float weight = 0.0;
+        for (unsigned int i = 0; i < numSamples; ++i)
+            weight += Sample.weights() ? Sample.weights()[i] : SaliencyWeight(Sample[i]);
+        factor = weight/(float)numSamples; //saliency factor
+    }
+    return factor;
+}
+
+unsigned int BSplineCurveFitterWindow3::JudgeLevels(SampleView Sample, unsigned int numOpen)
+{
+    SPLINE_STATS(fitStats.judgeCalls++);
+    SplineArena::Scope scope(mArena);
+
+    float factor = SaliencyFactor(Sample);
+    BindSamples(Sample);
+
+    // One sweep over the control count serves every open level: level k
+    // takes the first count whose error is below its tolerance. Coarser
+    // levels have larger tolerances and settle first; the sweep stops once
+    // the finest open level (level 0) has.
+    unsigned int numFailing = numOpen;
+    for (unsigned int level = 0; level < numOpen; ++level) levelFits[level].numControls = 0;
+    int minDegree;
+    for (int numControls = 2; numControls <= MAX_NUM_CONTROLS && numFailing > 0; numControls++)
+    {
+        // Errors above the largest open tolerance settle no level.
+        float bound = minErrorThreshold/factor;
+        for (unsigned int level = 1; level < numFailing; ++level)
+            bound = std::max(bound, minErrorThreshold*coarseScales[level - 1]/factor);
+        float error = JudgeControls(Sample, numControls, minDegree, bound);
+        for (unsigned int level = numFailing; level-- > 0; )
+        {
+            float scale = level == 0 ? 1.0f : coarseScales[level - 1];
+            if (!(error < minErrorThreshold*scale/factor)) break;
+            levelFits[level].numControls = numControls;
+            levelFits[level].degree = minDegree;
+            levelFits[level].controlData = roundControlData;
+            numFailing = level;
+        }
+    }
+    return numFailing;
+}
+
+void BSplineCurveFitterWindow3::CreateLevelPolyline(SampleView Sample, unsigned int depth, unsigned int numOpen)
+{
+    // Levels [0, numOpen) still need a fit of this piece; the coarser ones
+    // were settled by an enclosing piece.
+    SPLINE_STATS(fitStats.maxSplitDepth = std::max(fitStats.maxSplitDepth, depth));
+    unsigned int numFailing = JudgeLevels(Sample, numOpen);
+
+    for (unsigned int level = numFailing; level < numOpen; ++level)
+    {
+        LevelFit const& fit = levelFits[level];
+        DeterminedNumControls = fit.numControls;
+        DeterminedDegree = fit.degree;
+        DeterminedControlData = fit.controlData;
+        if (level == 0) EmitControlBlock(Sample.size());
+        else
+        {
+            CPforEachLayer_or_CC.swap(CPforEachLevel[level - 1]);
+            int previousTriple = TotalTriple;
+            EmitControlBlock(Sample.size());
+            TotalTriple = previousTriple; //only level 0 counts.
+            CPforEachLayer_or_CC.swap(CPforEachLevel[level - 1]);
+        }
+    }
+
+    if (numFailing > 0) //the finer levels need the piece split in the half.
+    {
+        CreateLevelPolyline(Sample.Sub(0, Sample.size()/2), depth + 1, numFailing);
+        CreateLevelPolyline(Sample.Sub(Sample.size()/2, Sample.size() - Sample.size()/2), depth + 1, numFailing);
+    }
+}
+
+void BSplineCurveFitterWindow3::FitOneBranch(SampleView branch, bool countOnly)
+{
+    countOnlyMode = countOnly;
+    if (countOnly) CalculateNeededCP(branch);
+    else if (levelsActive) CreateLevelPolyline(branch, 0, (unsigned int)levelFits.size());
+    else CreateBSplinePolyline(branch);
+    countOnlyMode = false;
+}
+
+float BSplineCurveFitterWindow3::Judge(SampleView Sample)
+{
+    float CPandError = 0;
+    SPLINE_STATS(fitStats.judgeCalls++);
+    SplineArena::Scope scope(mArena);
+
+    float threshold = minErrorThreshold/SaliencyFactor(Sample);
+    BindSamples(Sample);
+
+    int minDegree;
+    if (controlSearch == ControlSearch::Linear)
+    {
+        for (int numControls = 2; numControls <= MAX_NUM_CONTROLS; numControls++)
+        {
+            if (JudgeControls(Sample, numControls, minDegree, threshold) < threshold)
+            {
+                DeterminedNumControls = numControls;
+                DeterminedDegree = minDegree;
+                if (!countOnlyMode) DeterminedControlData.swap(roundControlData);
+                //cout<<" minError: "<<minError<<endl;
+                CPandError = numControls + minError;
+                return CPandError;
+            }
+        }
+        CPandError = 100;//assign an big enough value
+        return CPandError;
+    }
+
+    // Galloping: probe 2, 3, 5, 9, ... to bracket the first passing count,
+    // then binary search inside the bracket. numControls = 1 never passes.
+    int failControls = 1, passControls = 0;
+    int passDegree = 10;
+    float passError = 100.0f;
+    int numControls = 2, step = 1;
+    while (1)
+    {
+        if (JudgeControls(Sample, numControls, minDegree, threshold) < threshold)
+        {
+            passControls = numControls; passDegree = minDegree; passError = minError;
+            if (!countOnlyMode) DeterminedControlData.swap(roundControlData);
+            break;
+        }
+        failControls = numControls;
+        if (numControls == MAX_NUM_CONTROLS)
+        {
+            CPandError = 100;//assign an big enough value
+            return CPandError;
+        }
+        numControls = std::min(numControls + step, (int)MAX_NUM_CONTROLS);
+        step *= 2;
+    }
+    while (passControls - failControls > 1)
+    {
+        numControls = (failControls + passControls) / 2;
+        if (JudgeControls(Sample, numControls, minDegree, threshold) < threshold)
+        {
+            passControls = numControls; passDegree = minDegree; passError = minError;
+            if (!countOnlyMode) DeterminedControlData.swap(roundControlData);
+        }
+        else failControls = numControls;
+    }
+    minError = passError;
+    DeterminedNumControls = passControls;
+    DeterminedDegree = passDegree;
+    CPandError = passControls + passError;
+    return CPandError;
+}
+
+void BSplineCurveFitterWindow3::CalculateNeededCP(SampleView Sample, unsigned int depth)
+{
+    SPLINE_STATS(fitStats.maxSplitDepth = std::max(fitStats.maxSplitDepth, depth));
+    float cpError = Judge(Sample);
+    
+    if (cpError == (float)100 && segmentation == Segmentation::Greedy)
+        SegmentGreedy(Sample, true, depth + 1);
+    else if (cpError == (float)100) //the branch may be too long to fit well.
+    {
+        //split in the half; both halves are views of this branch.
+        SampleView first = Sample.Sub(0, Sample.size()/2);
+        SampleView second = Sample.Sub(Sample.size()/2, Sample.size() - Sample.size()/2);
+   
+        CalculateNeededCP(first, depth + 1);
+        CalculateNeededCP(second, depth + 1);
+    }
+    else 
+        TotalControlNum += DeterminedNumControls;
+}
+
+void BSplineCurveFitterWindow3::SegmentGreedy(SampleView Sample, bool countOnly, unsigned int depth)
+{
+    SPLINE_STATS(fitStats.maxSplitDepth = std::max(fitStats.maxSplitDepth, depth));
+    unsigned int numSamples = Sample.size();
+    unsigned int start = 0, guess = numSamples / 2;
+    array<float, MAX_NUM_CONTROLS * DIMENSION> pieceControlData;
+    while (start < numSamples)
+    {
+        // Find the longest piece starting at 'start' that Judge() accepts:
+        // gallop from the previous piece's length, then bisect the bracket.
+        unsigned int remaining = numSamples - start;
+        unsigned int passLength = 0, failLength = remaining + 1;
+        int pieceNumControls = 0, pieceDegree = 0;
+        unsigned int length = ClampPiece(guess, remaining);
+        while (1)
+        {
+            if (Judge(Sample.Sub(start, length)) != (float)100)
+            {
+                passLength = length;
+                pieceNumControls = DeterminedNumControls; pieceDegree = DeterminedDegree;
+                pieceControlData.swap(DeterminedControlData);
+            }
+            else failLength = length;
+
+            if (failLength > remaining) length = ClampPiece(2 * passLength, remaining); //still growing
+            else if (passLength == 0) length = ClampPiece(failLength / 2, remaining); //still shrinking
+            else length = ClampPiece((passLength + failLength) / 2, remaining);
+            if (length <= passLength || length >= failLength) break;
+        }
+        if (passLength == 0) //even the shortest piece failed; keep halving there.
+        {
+            if (countOnly) CalculateNeededCP(Sample.Sub(start, length), depth + 1);
+            else CreateBSplinePolyline(Sample.Sub(start, length), depth + 1);
+            start += length;
+            continue;
+        }
+
+        DeterminedNumControls = pieceNumControls; DeterminedDegree = pieceDegree;
+        DeterminedControlData.swap(pieceControlData);
+        if (countOnly) TotalControlNum += DeterminedNumControls;
+        else EmitControlBlock(passLength);
+        start += passLength;
+        guess = passLength;
+    }
+}
+
+unsigned int BSplineCurveFitterWindow3::ClampPiece(unsigned int length, unsigned int remaining)
+{
+    // A piece needs two samples to be fitted, and so does whatever it leaves.
+    if (length >= remaining) return remaining;
+    if (length < MIN_PIECE_LENGTH) length = MIN_PIECE_LENGTH;
+    if (remaining - length < MIN_PIECE_LENGTH)
+        length = remaining > 2 * MIN_PIECE_LENGTH ? remaining - MIN_PIECE_LENGTH : remaining;
+    return length;
+}
+
+void BSplineCurveFitterWindow3::CreateBSplinePolyline(SampleView Sample, unsigned int depth)
+{
+    SPLINE_STATS(fitStats.maxSplitDepth = std::max(fitStats.maxSplitDepth, depth));
+    float cpError = Judge(Sample);
+    
+    if (cpError == (float)100 && segmentation == Segmentation::Greedy)
+        SegmentGreedy(Sample, false, depth + 1);
+    else if (cpError == (float)100) //the branch may be too long to fit well.
+    {
+        //split in the half; both halves are views of this branch.
+        SampleView first = Sample.Sub(0, Sample.size()/2);
+        SampleView second = Sample.Sub(Sample.size()/2, Sample.size() - Sample.size()/2);
+   
+        CreateBSplinePolyline(first, depth + 1);
+        CreateBSplinePolyline(second, depth + 1);
+    }
+    else
+        EmitControlBlock(Sample.size());
+}
+
+void BSplineCurveFitterWindow3::EmitControlBlock(unsigned int numSamples)
+{
+    // Judge() kept the control points of the winning candidate.
+    //cout<< DeterminedNumControls <<" "<<DeterminedDegree<<" "; 
+    vector<Vector3<float>> CPforEachBranch; 
+    Vector3<float> eachTriple;
+    eachTriple[0] = DeterminedNumControls;
+    eachTriple[1] = DeterminedDegree;
+    eachTriple[2] = numSamples;
+    CPforEachBranch.push_back(eachTriple);
+    
+    
+    float const* controlDataPtr = &DeterminedControlData[0];
+    for (int i = 0; i< DeterminedNumControls; ++i)
+    {
+        for (int j = 0; j < DIMENSION; ++j)
+        {
+            //controlData[i][j] = (*controlDataPtr);
+            //cout<<(round)(*controlDataPtr*diagonal)<<" ";
+            eachTriple[j] = (round)(*controlDataPtr*diagonal);
+            controlDataPtr++;
+        }
+        CPforEachBranch.push_back(eachTriple);
+    
+    }    
+    //cout<<"CPforEachLayer_or_CC.size "<<CPforEachLayer_or_CC.size()<<endl;
+    CPforEachLayer_or_CC.push_back(CPforEachBranch);
+    TotalTriple += (DeterminedNumControls+1);
+}
+
+float BSplineCurveFitterWindow3::JudgeMergeCandidate(unsigned int first, unsigned int second)
+{
+    array<unsigned int, 4> key = {first, branchVersion[first], second, 0};
+    if (second != NO_BRANCH) key[3] = branchVersion[second];
+
+    auto found = judgeCache.find(key);
+    if (found != judgeCache.end())
+    {
+        mergeCacheStats.hits++;
+        return found->second;
+    }
+    mergeCacheStats.misses++;
+
+    SampleView tail = second == NO_BRANCH ? SampleView() : SampleView(sampleSet[second]);
+    float CPandError = ScoreMergeCandidate(sampleSet[first], tail);
+    judgeCache.emplace(key, CPandError);
+    return CPandError;
+}
+
+float BSplineCurveFitterWindow3::ScoreMergeCandidate(SampleView head, SampleView tail)
+{
+    SplineArena::Scope scope(mArena);
+    if (tail.size() == 0) return Judge(WeighBranch(head));
+    unsigned int numMerged = head.size() + tail.size();
+    Vector3<float>* merge = mArena.Allocate<Vector3<float>>(numMerged);
+    std::copy(head.data(), head.data() + head.size(), merge);
+    std::copy(tail.data(), tail.data() + tail.size(), merge + head.size());
+    return Judge(WeighBranch(SampleView(merge, numMerged)));
+}
+
+void BSplineCurveFitterWindow3::ScoreMergeCandidates(vector<array<unsigned int, 2>> const& candidates)
+{
+    // Fills judgeCache for (branch, NO_BRANCH) and (head, tail) pairs on the
+    // worker fitters. Serially, JudgeMergeCandidate scores them on demand.
+    if (numThreads <= 1) return;
+    vector<array<unsigned int, 4>> keys;
+    for (auto const& candidate : candidates)
+    {
+        unsigned int first = candidate[0], second = candidate[1];
+        size_t numSamples = sampleSet[first].size();
+        if (second != NO_BRANCH) numSamples += sampleSet[second].size();
+        if (!deleteshort && numSamples < MinAllowableLength) continue; //MergeGain() won't ask.
+        array<unsigned int, 4> key = {first, branchVersion[first], second, 0};
+        if (second != NO_BRANCH) key[3] = branchVersion[second];
+        if (judgeCache.count(key) == 0) keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    auto numSamples = [this](array<unsigned int, 4> const& key)
+    { return sampleSet[key[0]].size() + (key[2] == NO_BRANCH ? 0 : sampleSet[key[2]].size()); };
+    vector<unsigned int> order(keys.size());
+    for (unsigned int i = 0; i < keys.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+        { return numSamples(keys[a]) > numSamples(keys[b]); });
+
+    PrepareWorkers();
+    vector<float> scores(keys.size());
+    mPool->Run(order, [&](unsigned int i, unsigned int w)
+    {
+        SampleView tail = keys[i][2] == NO_BRANCH ? SampleView() : SampleView(sampleSet[keys[i][2]]);
+        scores[i] = mWorkers[w]->ScoreMergeCandidate(sampleSet[keys[i][0]], tail);
+    });
+    for (auto& worker : mWorkers) fitStats.Add(worker->fitStats);
+    for (unsigned int i = 0; i < keys.size(); i++) judgeCache.emplace(keys[i], scores[i]);
+    mergeCacheStats.misses += keys.size();
+}
+
+float BSplineCurveFitterWindow3::MergeGain(unsigned int first, unsigned int second)
+{
+    // Control points (plus error) saved by appending 'second' to 'first',
+    // with the fixed costs the sequential walk gives short branches.
+    size_t firstSize = sampleSet[first].size(), secondSize = sampleSet[second].size();
+    float firstE, secondE, mergeE;
+    if (!deleteshort && firstSize < MinAllowableLength) firstE = 2.01;
+    else firstE = JudgeMergeCandidate(first, NO_BRANCH);
+    if (!deleteshort && secondSize < MinAllowableLength) secondE = 2.01;
+    else secondE = JudgeMergeCandidate(second, NO_BRANCH);
+    if (!deleteshort && firstSize + secondSize < MinAllowableLength) mergeE = 4;
+    else mergeE = JudgeMergeCandidate(first, second);
+    return firstE + secondE - mergeE;
+}
+
+void BSplineCurveFitterWindow3::Merge()
+{
+    branchVersion.assign(sampleSet.size(), 0);
+    judgeCache.clear();
+    mergeCacheStats = MergeCacheStats();
+
+    if (mergeStrategy == MergeStrategy::BestGain) MergeBestGain();
+    else MergeSequential();
+
+    // Squeeze out the branches merges left empty, keeping the order; the
+    // first branch always stays.
+    if (sampleSet.empty()) return;
+    unsigned int numKept = 1;
+    for (unsigned int i = 1; i < sampleSet.size(); i++)
+    {
+        if (sampleSet[i].empty()) continue;
+        if (numKept != i) sampleSet[numKept].swap(sampleSet[i]);
+        numKept++;
+    }
+    sampleSet.resize(numKept);
+}
+
+void BSplineCurveFitterWindow3::MergeBestGain()
+{
+    // Candidate c appends branch candidates[c][1] to branch candidates[c][0].
+    // Branches keep their index in sampleSet; a merged-away branch is left
+    // empty until Merge() squeezes the set.
+    vector<array<unsigned int, 2>> candidates;
+    for (int* sampleIndex : connection)
+    {
+        for (int index = 1; index < 4; index++)
+        {
+            if (sampleIndex[index] == 0 || sampleIndex[index] == sampleIndex[0]) continue;
+            candidates.push_back({(unsigned int)sampleIndex[0], (unsigned int)sampleIndex[index]});
+        }
+    }
+    vector<vector<unsigned int>> touching(sampleSet.size());
+    vector<array<unsigned int, 2>> pairs;
+    for (unsigned int c = 0; c < candidates.size(); c++)
+    {
+        touching[candidates[c][0]].push_back(c);
+        touching[candidates[c][1]].push_back(c);
+        pairs.push_back({candidates[c][0], NO_BRANCH});
+        pairs.push_back({candidates[c][1], NO_BRANCH});
+        pairs.push_back(candidates[c]);
+    }
+    ScoreMergeCandidates(pairs);
+
+    struct Entry { float gain; unsigned int candidate, headVersion, tailVersion; };
+    auto lower = [](Entry const& a, Entry const& b)
+    { return a.gain != b.gain ? a.gain < b.gain : a.candidate > b.candidate; };
+    priority_queue<Entry, vector<Entry>, decltype(lower)> queue(lower);
+    auto score = [&](unsigned int c)
+    {
+        unsigned int head = candidates[c][0], tail = candidates[c][1];
+        if (sampleSet[head].empty() || sampleSet[tail].empty()) return;
+        float gain = MergeGain(head, tail);
+        if (gain > 0) queue.push({gain, c, branchVersion[head], branchVersion[tail]});
+    };
+    for (unsigned int c = 0; c < candidates.size(); c++) score(c);
+
+    while (!queue.empty())
+    {
+        Entry best = queue.top();
+        queue.pop();
+        unsigned int head = candidates[best.candidate][0], tail = candidates[best.candidate][1];
+        if (best.headVersion != branchVersion[head] || best.tailVersion != branchVersion[tail]) continue;
+
+        vector<Vector3<float>>& target = sampleSet[head];
+        target.insert(target.end(), sampleSet[tail].begin(), sampleSet[tail].end());
+        vector<Vector3<float>>().swap(sampleSet[tail]);
+        branchVersion[head]++;
+        branchVersion[tail]++;
+        for (unsigned int c : touching[head]) score(c);
+    }
+}
+
+void BSplineCurveFitterWindow3::MergeSequential()
+{
+    SampleView first, second;
+    float minEandContlNum = 100.0;
+    //float maxdiff = 0.0;
+    int minIndex = 1000;
+    float firstE,secondE,mergeE;
+
+    //vector<int> GapFill;////
+    //outMerge.open("outMerge.txt");
+  //time:0.007
+    //clock_t start = clock();
+    for(auto it = connection.begin();it!=connection.end();it++)
+    {
+        int *sampleIndex = *it;
+        //cout<<out[0]<<"--"<<out[1]<<"--"<<out[2]<<"--"<<out[3]<<endl;
+        first = sampleSet[sampleIndex[0]];
+        if (deleteshort) firstE = JudgeMergeCandidate(sampleIndex[0], NO_BRANCH);
+        else 
+        {
+            if (first.size()<MinAllowableLength) firstE = 2.01;//
+            else firstE = JudgeMergeCandidate(sampleIndex[0], NO_BRANCH);
+        }
+
+        for(int index = 1; index < 4; index++)//index for 'sampleIndex'.
+        {
+            if(sampleIndex[index]==0) continue;
+            second = sampleSet[sampleIndex[index]];
+                
+            if (deleteshort) secondE = JudgeMergeCandidate(sampleIndex[index], NO_BRANCH);
+            else 
+            {
+                if(second.size()<MinAllowableLength) secondE = 2.01;//assign a big num.
+                else secondE = JudgeMergeCandidate(sampleIndex[index], NO_BRANCH);
+            }
+
+            if (deleteshort) mergeE = JudgeMergeCandidate(sampleIndex[0], sampleIndex[index]);
+            else
+            {
+                if ((first.size()+second.size())<MinAllowableLength) mergeE = 4; //about 3CP + 0.- error.
+                else mergeE = JudgeMergeCandidate(sampleIndex[0], sampleIndex[index]);
+            }
+    
+            //cout<<"mergeE: "<<mergeE<<" firstE: "<<firstE<<" secondE: "<<secondE<<endl;
+            if (mergeE < (firstE + secondE)) 
+                if (minEandContlNum > mergeE) { minEandContlNum = mergeE; minIndex = sampleIndex[index];}
+            
+        }
+        if (minIndex!=1000) //meet the merge condition.
+        {
+            //cout<<"Merge！ first: "<<sampleIndex[0]<<" second: "<<minIndex<<endl;
+            second = sampleSet[minIndex];
+            vector<Vector3<float>> merge;
+            merge.reserve(first.size()+second.size());
+            merge.insert(merge.end(), first.data(), first.data()+first.size());
+            merge.insert(merge.end(), second.data(), second.data()+second.size());
+
+            //for (unsigned int i = 0; i<merge.size(); i++)
+            //    outMerge<<iter<<" "<<merge[i][0]*diagonal<<" "<<merge[i][1]*diagonal<<" "<<merge[i][2]*diagonal<<endl;
+        
+
+            sampleSet[sampleIndex[0]].swap(merge);
+            //sampleSet.erase(sampleSet.begin()+minIndex);
+            sampleSet[minIndex].clear();//still occupy the position.
+            branchVersion[sampleIndex[0]]++;//cached scores of both branches are stale now.
+            branchVersion[minIndex]++;
+
+            minEandContlNum = 100.0f;
+            minIndex = 1000;
+        }
+        
+    }
+
+    //outMerge.close();
+    //cout<<"--"<<sampleSet.size()<<endl;
+     
+}
@@ -0,0 +1,184 @@
+#include "BSplineFitEngine.h"
+#include <cmath>
+#include <algorithm>
+
+template <int N, typename Real>
+BSplineFitEngine<N, Real>::BSplineFitEngine(SplineArena& arena)
+    :
+    mArena(arena),
+    mSamples(nullptr),
+    mNumSamples(0),
+    mParams(nullptr),
+    mDegree(0),
+    mNumControls(0),
+    mKnots(nullptr),
+    mBand(nullptr),
+    mRhs(nullptr),
+    mControlData(nullptr)
+{
+}
+
+template <int N, typename Real>
+void BSplineFitEngine<N, Real>::SetSamples(Vector<N, Real> const* samples, unsigned int numSamples)
+{
+    mSamples = samples;
+    mNumSamples = numSamples;
+
+    // Same parameterization as BSplineCurveFit.
+    Real tMultiplier = (Real)1 / (Real)(numSamples - 1);
+    mParams = mArena.Allocate<Real>(numSamples);
+    for (unsigned int i = 0; i < numSamples; ++i)
+        mParams[i] = tMultiplier * (Real)i;
+}
+
+template <int N, typename Real>
+int BSplineFitEngine<N, Real>::FindSpan(double t) const
+{
+    if (t <= 0.0) return mDegree;
+    if (t >= 1.0) return mNumControls - 1;
+    int span = mDegree + (int)(t * (mNumControls - mDegree));
+    span = std::min(std::max(span, mDegree), mNumControls - 1);
+    while (span > mDegree && t < mKnots[span]) --span;
+    while (span < mNumControls - 1 && t >= mKnots[span + 1]) ++span;
+    return span;
+}
+
+template <int N, typename Real>
+void BSplineFitEngine<N, Real>::EvaluateBasis(int span, double t, double* values) const
+{
+    // Cox-de Boor triangle; values[k] belongs to basis function span-degree+k.
+    double left[MAX_DEGREE + 1], right[MAX_DEGREE + 1];
+    values[0] = 1.0;
+    for (int j = 1; j <= mDegree; ++j)
+    {
+        left[j] = t - mKnots[span + 1 - j];
+        right[j] = mKnots[span + j] - t;
+        double saved = 0.0;
+        for (int r = 0; r < j; ++r)
+        {
+            double temp = values[r] / (right[r + 1] + left[j - r]);
+            values[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        values[j] = saved;
+    }
+}
+
+template <int N, typename Real>
+bool BSplineFitEngine<N, Real>::Fit(int degree, int numControls)
+{
+    mDegree = degree;
+    mNumControls = numControls;
+    if (degree < 1 || degree > MAX_DEGREE || degree >= numControls || numControls > (int)mNumSamples)
+        return false;
+
+    // Open uniform knot vector.
+    int numKnots = numControls + degree + 1;
+    mKnots = mArena.Allocate<double>(numKnots);
+    for (int i = 0; i < numKnots; ++i)
+    {
+        if (i <= degree) mKnots[i] = 0.0;
+        else if (i >= numControls) mKnots[i] = 1.0;
+        else mKnots[i] = (double)(i - degree) / (double)(numControls - degree);
+    }
+
+    // Accumulate the normal equations, one basis evaluation per sample.
+    int bandWidth = degree + 1;
+    mBand = mArena.Allocate<double>(numControls * bandWidth);
+    mRhs = mArena.Allocate<double>(numControls * N);
+    std::fill(mBand, mBand + numControls * bandWidth, 0.0);
+    std::fill(mRhs, mRhs + numControls * N, 0.0);
+    double basis[MAX_DEGREE + 1];
+    for (unsigned int s = 0; s < mNumSamples; ++s)
+    {
+        double t = mParams[s];
+        int span = FindSpan(t);
+        EvaluateBasis(span, t, basis);
+        int first = span - degree;
+        for (int a = 0; a <= degree; ++a)
+        {
+            double* row = &mBand[(first + a) * bandWidth];
+            for (int b = 0; b <= a; ++b)
+                row[degree - (a - b)] += basis[a] * basis[b];
+            double* rhs = &mRhs[(first + a) * N];
+            for (int j = 0; j < N; ++j)
+                rhs[j] += basis[a] * mSamples[s][j];
+        }
+    }
+
+    // Banded Cholesky factorization A^T*A = L*L^T, in place.
+    for (int i = 0; i < numControls; ++i)
+    {
+        double* rowI = &mBand[i * bandWidth];
+        int jMin = std::max(0, i - degree);
+        for (int j = jMin; j <= i; ++j)
+        {
+            double* rowJ = &mBand[j * bandWidth];
+            double sum = rowI[degree - (i - j)];
+            for (int k = jMin; k < j; ++k)
+                sum -= rowI[degree - (i - k)] * rowJ[degree - (j - k)];
+            if (i == j)
+            {
+                if (!(sum > 0.0)) return false;
+                rowI[degree] = std::sqrt(sum);
+            }
+            else rowI[degree - (i - j)] = sum / rowJ[degree];
+        }
+    }
+
+    // Forward and back substitution for the three coordinates at once.
+    for (int i = 0; i < numControls; ++i)
+    {
+        double const* rowI = &mBand[i * bandWidth];
+        double* x = &mRhs[i * N];
+        for (int k = std::max(0, i - degree); k < i; ++k)
+        {
+            double l = rowI[degree - (i - k)];
+            for (int j = 0; j < N; ++j) x[j] -= l * mRhs[k * N + j];
+        }
+        for (int j = 0; j < N; ++j) x[j] /= rowI[degree];
+    }
+    for (int i = numControls - 1; i >= 0; --i)
+    {
+        double* x = &mRhs[i * N];
+        int kMax = std::min(numControls - 1, i + degree);
+        for (int k = i + 1; k <= kMax; ++k)
+        {
+            double l = mBand[k * bandWidth + degree - (k - i)];
+            for (int j = 0; j < N; ++j) x[j] -= l * mRhs[k * N + j];
+        }
+        for (int j = 0; j < N; ++j) x[j] /= mBand[i * bandWidth + degree];
+    }
+
+    mControlData = mArena.Allocate<Real>(numControls * N);
+    for (int i = 0; i < numControls * N; ++i)
+        mControlData[i] = (Real)mRhs[i];
+
+    // Like BSplineCurveFit, pin the end control points to the end samples.
+    for (int j = 0; j < N; ++j)
+    {
+        mControlData[j] = mSamples[0][j];
+        mControlData[(numControls - 1) * N + j] = mSamples[mNumSamples - 1][j];
+    }
+    return true;
+}
+
+template <int N, typename Real>
+void BSplineFitEngine<N, Real>::GetPosition(Real t, Real* position) const
+{
+    double basis[MAX_DEGREE + 1];
+    int span = FindSpan(t);
+    EvaluateBasis(span, t, basis);
+    double sum[N] = {};
+    Real const* source = &mControlData[(span - mDegree) * N];
+    for (int a = 0; a <= mDegree; ++a)
+    {
+        for (int j = 0; j < N; ++j)
+            sum[j] += basis[a] * (*source++);
+    }
+    for (int j = 0; j < N; ++j)
+        position[j] = (Real)sum[j];
+}
+
+template class BSplineFitEngine<3, float>;
+template class BSplineFitEngine<3, double>;
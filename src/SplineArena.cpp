@@ -0,0 +1,77 @@
+#include "SplineArena.h"
+#include <algorithm>
+#include <new>
+
+SplineArena::SplineArena()
+    :
+    mBlock(0),
+    mOffset(0)
+{
+}
+
+SplineArena::~SplineArena()
+{
+    for (auto& block : mBlocks) ::operator delete(block.data);
+}
+
+void* SplineArena::AllocateBytes(size_t size)
+{
+    mStats.allocations++;
+    if (size == 0) return nullptr;
+
+    size_t offset = (mOffset + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    while (mBlock < mBlocks.size() && offset + size > mBlocks[mBlock].size)
+    {
+        // Move on to the next block; what is left of this one stays unused
+        // until the scope that filled it ends.
+        if (mBlock + 1 == mBlocks.size()) { mBlock++; break; }
+        mBlock++;
+        offset = 0;
+    }
+    if (mBlock == mBlocks.size())
+    {
+        size_t blockSize = MIN_BLOCK_SIZE;
+        if (!mBlocks.empty()) blockSize = std::max(blockSize, 2 * mBlocks.back().size);
+        blockSize = std::max(blockSize, size);
+        mBlocks.push_back(Block{static_cast<unsigned char*>(::operator new(blockSize)), blockSize});
+        mStats.heapAllocations++;
+        mStats.reservedBytes += blockSize;
+        offset = 0;
+    }
+
+    mOffset = offset + size;
+    mStats.peakBytes = std::max(mStats.peakBytes, BytesInUse());
+    return mBlocks[mBlock].data + offset;
+}
+
+size_t SplineArena::BytesInUse() const
+{
+    // Earlier blocks count as full.
+    size_t bytes = mOffset;
+    for (size_t i = 0; i < mBlock && i < mBlocks.size(); ++i) bytes += mBlocks[i].size;
+    return bytes;
+}
+
+void SplineArena::Rewind(Marker marker)
+{
+    mBlock = marker.block;
+    mOffset = marker.offset;
+}
+
+void SplineArena::Reset()
+{
+    mBlock = 0;
+    mOffset = 0;
+    if (mBlocks.size() <= 1) return;
+
+    size_t blockSize = 0;
+    for (auto& block : mBlocks)
+    {
+        blockSize += block.size;
+        ::operator delete(block.data);
+    }
+    mBlocks.clear();
+    mBlocks.push_back(Block{static_cast<unsigned char*>(::operator new(blockSize)), blockSize});
+    mStats.heapAllocations++;
+    mStats.reservedBytes = blockSize;
+}
@@ -0,0 +1,257 @@
+#include "SplineCPStream.h"
+#include "BSplineBatchEvaluator.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const unsigned char Magic[4] = {'S', 'P', 'C', 'P'};
+static const unsigned char Version = 1;
+static const size_t HeaderSize = 12;
+
+static void PutVarint(vector<unsigned char>& bytes, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back((unsigned char)value);
+}
+
+static bool GetVarint(unsigned char const*& current, unsigned char const* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && current < end; shift += 7)
+    {
+        unsigned char byte = *current++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static inline uint64_t ZigZag(long long value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline long long UnZigZag(uint64_t value)
+{
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+static bool ToInteger(float value, long long& integer)
+{
+    if (!(std::fabs(value) <= 2147483647.0f) || value != std::floor(value)) return false;
+    integer = (long long)value;
+    return true;
+}
+
+static_assert((int)SPLINE_CP_MAX_DEGREE == (int)BSplineBatchEvaluator<3, float>::MAX_DEGREE,
+    "a decodable degree must be one the evaluators accept");
+
+bool IsValidSplineCPBranch(unsigned int numEntries, long long CPnum, long long degree, long long numSamples)
+{
+    if (numEntries < 2 || CPnum != (long long)numEntries - 1) return false;
+    if (CPnum == 1) return true;
+    return degree >= 1 && degree < CPnum && degree <= SPLINE_CP_MAX_DEGREE &&
+        numSamples >= 0 && numSamples <= SPLINE_CP_MAX_NUM_SAMPLES;
+}
+
+bool EncodeSplineCP(vector<vector<vector<Vector3<float>>>> const& index, float diagonal, vector<unsigned char>& bytes)
+{
+    bytes.assign(Magic, Magic + 4);
+    bytes.push_back(Version);
+    bytes.insert(bytes.end(), 3, 0);
+    uint32_t diagonalBits;
+    memcpy(&diagonalBits, &diagonal, sizeof(diagonalBits));
+    for (int i = 0; i < 4; ++i) bytes.push_back((unsigned char)(diagonalBits >> (8 * i)));
+    PutVarint(bytes, index.size());
+
+    vector<unsigned char> layerBytes;
+    for (auto const& layer : index)
+    {
+        layerBytes.clear();
+        PutVarint(layerBytes, layer.size());
+        long long previous[3] = {0, 0, 0};
+        for (auto const& branch : layer)
+        {
+            PutVarint(layerBytes, branch.size());
+            if (branch.empty()) continue;
+            long long header[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                if (!ToInteger(branch[0][j], header[j]) || header[j] < 0) return false;
+                PutVarint(layerBytes, (uint64_t)header[j]);
+            }
+            if (branch.size() > 0xffffffffull ||
+                !IsValidSplineCPBranch((unsigned int)branch.size(), header[0], header[1], header[2]))
+                return false;
+            for (size_t i = 1; i < branch.size(); ++i)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    long long value;
+                    if (!ToInteger(branch[i][j], value)) return false;
+                    PutVarint(layerBytes, ZigZag(value - previous[j]));
+                    previous[j] = value;
+                }
+            }
+        }
+        PutVarint(bytes, layerBytes.size());
+        bytes.insert(bytes.end(), layerBytes.begin(), layerBytes.end());
+    }
+    return true;
+}
+
+bool WriteSplineCP(string const& path, vector<vector<vector<Vector3<float>>>> const& index, float diagonal)
+{
+    vector<unsigned char> bytes;
+    if (!EncodeSplineCP(index, diagonal, bytes)) return false;
+    ofstream out(path, ios::binary);
+    out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+    return (bool)out;
+}
+
+SplineCPReader::Cursor::Cursor()
+    :
+    mCurrent(nullptr),
+    mEnd(nullptr),
+    mNumBranches(0),
+    mNumRead(0),
+    mPrevious{0, 0, 0}
+{
+}
+
+bool SplineCPReader::Cursor::Next(SplineCPBranch& branch, vector<float>& points)
+{
+    if (mNumRead == mNumBranches) return false;
+    ++mNumRead;
+
+    uint64_t value;
+    if (!GetVarint(mCurrent, mEnd, value)) return false;
+    branch.numEntries = (unsigned int)value;
+    branch.CPnum = 0; branch.degree = 0; branch.numSamples = 0;
+    points.clear();
+    if (branch.numEntries == 0) return true;
+
+    uint64_t header[3];
+    for (int j = 0; j < 3; ++j)
+        if (!GetVarint(mCurrent, mEnd, header[j])) return false;
+    // Every point takes at least three bytes, which bounds 'points' by the
+    // layer size before it is allocated.
+    if (value > 0xffffffffull || (value - 1) > (uint64_t)(mEnd - mCurrent) / 3) return false;
+    if (header[0] > 0xffffffffull || header[1] > 0xffffffffull || header[2] > 0xffffffffull) return false;
+    if (!IsValidSplineCPBranch(branch.numEntries, (long long)header[0], (long long)header[1], (long long)header[2]))
+        return false;
+    branch.CPnum = (int)header[0];
+    branch.degree = (int)header[1];
+    branch.numSamples = (unsigned int)header[2];
+
+    points.resize(3 * (branch.numEntries - 1));
+    for (unsigned int i = 0; i + 1 < branch.numEntries; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            if (!GetVarint(mCurrent, mEnd, value)) return false;
+            mPrevious[j] += UnZigZag(value);
+            points[3 * i + j] = (float)mPrevious[j];
+        }
+    }
+    return true;
+}
+
+SplineCPReader::SplineCPReader()
+    :
+    mData(nullptr),
+    mSize(0),
+    mMapping(nullptr),
+    mDiagonal(0.0f)
+{
+}
+
+SplineCPReader::~SplineCPReader()
+{
+    Close();
+}
+
+bool SplineCPReader::Open(string const& path)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    mMapping = mapping;
+    mData = static_cast<unsigned char const*>(mapping);
+    mSize = (size_t)info.st_size;
+    if (Index()) return true;
+    Close();
+    return false;
+}
+
+bool SplineCPReader::Attach(unsigned char const* data, size_t size)
+{
+    Close();
+    mData = data;
+    mSize = size;
+    if (Index()) return true;
+    Close();
+    return false;
+}
+
+void SplineCPReader::Close()
+{
+    if (mMapping) munmap(mMapping, mSize);
+    mMapping = nullptr;
+    mData = nullptr;
+    mSize = 0;
+    mDiagonal = 0.0f;
+    mLayers.clear();
+    mLayerEnds.clear();
+}
+
+bool SplineCPReader::Index()
+{
+    if (mSize < HeaderSize || memcmp(mData, Magic, 4) != 0 || mData[4] != Version) return false;
+    uint32_t diagonalBits = 0;
+    for (int i = 0; i < 4; ++i) diagonalBits |= (uint32_t)mData[8 + i] << (8 * i);
+    memcpy(&mDiagonal, &diagonalBits, sizeof(mDiagonal));
+
+    unsigned char const* current = mData + HeaderSize;
+    unsigned char const* end = mData + mSize;
+    uint64_t numLayers, numBytes;
+    if (!GetVarint(current, end, numLayers)) return false;
+    for (uint64_t i = 0; i < numLayers; ++i)
+    {
+        if (!GetVarint(current, end, numBytes) || numBytes > (uint64_t)(end - current)) return false;
+        mLayers.push_back(current - mData);
+        current += numBytes;
+        mLayerEnds.push_back(current - mData);
+    }
+    return true;
+}
+
+SplineCPReader::Cursor SplineCPReader::GetLayer(size_t layer) const
+{
+    Cursor cursor;
+    if (layer >= mLayers.size()) return cursor;
+    cursor.mCurrent = mData + mLayers[layer];
+    cursor.mEnd = mData + mLayerEnds[layer];
+    uint64_t numBranches;
+    if (GetVarint(cursor.mCurrent, cursor.mEnd, numBranches)) cursor.mNumBranches = (unsigned int)numBranches;
+    return cursor;
+}
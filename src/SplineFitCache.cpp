@@ -0,0 +1,116 @@
+#include "SplineFitCache.h"
+#include <algorithm>
+#include <cstring>
+
+SplineFitCache::SplineFitCache()
+    :
+    mMaxBytes(0)
+{
+}
+
+void SplineFitCache::SetMaxBytes(size_t maxBytes)
+{
+    mMaxBytes = maxBytes;
+    Evict();
+}
+
+void SplineFitCache::Clear()
+{
+    mNodes.clear();
+    mIndex.clear();
+    mStats.entries = 0;
+    mStats.bytes = 0;
+}
+
+uint64_t SplineFitCache::Hash(void const* data, size_t numBytes, uint64_t hash)
+{
+    unsigned char const* bytes = static_cast<unsigned char const*>(data);
+    for (size_t i = 0; i < numBytes; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+SplineFitCache::NodeIterator SplineFitCache::Lookup(uint64_t hash, uint64_t context,
+    Vector3<float> const* samples, size_t numSamples)
+{
+    auto range = mIndex.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        Node const& node = *it->second;
+        if (node.context == context && node.samples.size() == numSamples &&
+            (numSamples == 0 || std::memcmp(node.samples.data(), samples, numSamples * sizeof(Vector3<float>)) == 0))
+            return it->second;
+    }
+    return mNodes.end();
+}
+
+SplineFitCache::Entry const* SplineFitCache::Find(uint64_t context, Vector3<float> const* samples, size_t numSamples)
+{
+    if (!IsEnabled()) return nullptr;
+    mStats.lookups++;
+    uint64_t hash = Hash(samples, numSamples * sizeof(Vector3<float>), context);
+    NodeIterator node = Lookup(hash, context, samples, numSamples);
+    if (node == mNodes.end()) return nullptr;
+    mStats.hits++;
+    mNodes.splice(mNodes.begin(), mNodes, node);
+    return &node->entry;
+}
+
+void SplineFitCache::Insert(uint64_t context, Vector3<float> const* samples, size_t numSamples, Entry&& entry)
+{
+    if (!IsEnabled()) return;
+    uint64_t hash = Hash(samples, numSamples * sizeof(Vector3<float>), context);
+    NodeIterator old = Lookup(hash, context, samples, numSamples);
+    if (old != mNodes.end()) Erase(old);
+
+    // Payload plus a rough allowance for the list, index and vector headers.
+    size_t bytes = sizeof(Node) + 64 + numSamples * sizeof(Vector3<float>);
+    for (auto const& level : entry.blocks)
+    {
+        bytes += sizeof(level);
+        for (auto const& block : level)
+            bytes += sizeof(block) + block.size() * sizeof(Vector3<float>);
+    }
+    if (bytes > mMaxBytes) return;
+
+    mNodes.push_front(Node());
+    Node& node = mNodes.front();
+    node.hash = hash;
+    node.context = context;
+    node.samples.assign(samples, samples + numSamples);
+    node.entry = std::move(entry);
+    node.bytes = bytes;
+    mIndex.emplace(hash, mNodes.begin());
+    mStats.insertions++;
+    mStats.entries++;
+    mStats.bytes += bytes;
+    Evict();
+}
+
+void SplineFitCache::Erase(NodeIterator node)
+{
+    auto range = mIndex.equal_range(node->hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == node)
+        {
+            mIndex.erase(it);
+            break;
+        }
+    }
+    mStats.entries--;
+    mStats.bytes -= node->bytes;
+    mNodes.erase(node);
+}
+
+void SplineFitCache::Evict()
+{
+    while (mStats.bytes > mMaxBytes && !mNodes.empty())
+    {
+        Erase(std::prev(mNodes.end()));
+        mStats.evictions++;
+    }
+}
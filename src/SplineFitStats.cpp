@@ -0,0 +1,28 @@
+#include "SplineFitStats.h"
+#include <algorithm>
+#include <sstream>
+
+void SplineFitStats::Add(SplineFitStats const& other)
+{
+    judgeCalls += other.judgeCalls;
+    candidateFits += other.candidateFits;
+    maxSplitDepth = std::max(maxSplitDepth, other.maxSplitDepth);
+    distanceEvaluations += other.distanceEvaluations;
+    fitSeconds += other.fitSeconds;
+    errorSeconds += other.errorSeconds;
+    reconstructionSeconds += other.reconstructionSeconds;
+}
+
+string SplineFitStats::ToJson() const
+{
+    ostringstream out;
+    out << "{\"judgeCalls\": " << judgeCalls
+        << ", \"candidateFits\": " << candidateFits
+        << ", \"maxSplitDepth\": " << maxSplitDepth
+        << ", \"distanceEvaluations\": " << distanceEvaluations
+        << ", \"fitSeconds\": " << fitSeconds
+        << ", \"errorSeconds\": " << errorSeconds
+        << ", \"reconstructionSeconds\": " << reconstructionSeconds
+        << "}";
+    return out.str();
+}
@@ -0,0 +1,170 @@
+#include "SplineHausdorff.h"
+#include "SplineFitStats.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+template <int N, typename Real>
+SplineHausdorff<N, Real>::SplineHausdorff(SplineArena& arena)
+    :
+    mArena(arena),
+    mSamples(nullptr),
+    mNumSamples(0),
+    mNumRuns(0),
+    mNumLeaves(0),
+    mBoxMin(nullptr),
+    mBoxMax(nullptr),
+    mStack(nullptr),
+    mNumDistances(0)
+{
+}
+
+template <int N, typename Real>
+void SplineHausdorff<N, Real>::Build(Vector<N, Real> const* splineSamples, unsigned int numSplineSamples)
+{
+    mSamples = splineSamples;
+    mNumSamples = numSplineSamples;
+    mNumRuns = (numSplineSamples + RUN_SIZE - 1) / RUN_SIZE;
+    mNumLeaves = 1;
+    unsigned int numLevels = 1;
+    while (mNumLeaves < mNumRuns) { mNumLeaves <<= 1; numLevels++; }
+
+    // Empty leaves keep an inverted box, which is infinitely far from any point.
+    Real const inf = std::numeric_limits<Real>::infinity();
+    Vector<N, Real> emptyMin, emptyMax;
+    for (int j = 0; j < N; ++j) { emptyMin[j] = inf; emptyMax[j] = -inf; }
+    mBoxMin = mArena.Allocate<Vector<N, Real>>(2 * mNumLeaves);
+    mBoxMax = mArena.Allocate<Vector<N, Real>>(2 * mNumLeaves);
+    std::fill(mBoxMin, mBoxMin + 2 * mNumLeaves, emptyMin);
+    std::fill(mBoxMax, mBoxMax + 2 * mNumLeaves, emptyMax);
+    // Each level pops one node and pushes two, so the stack never holds more
+    // than one entry per level plus one.
+    mStack = mArena.Allocate<unsigned int>(numLevels + 1);
+
+    for (unsigned int run = 0; run < mNumRuns; ++run)
+    {
+        Vector<N, Real>& boxMin = mBoxMin[mNumLeaves + run];
+        Vector<N, Real>& boxMax = mBoxMax[mNumLeaves + run];
+        unsigned int end = std::min((run + 1) * RUN_SIZE, mNumSamples);
+        for (unsigned int i = run * RUN_SIZE; i < end; ++i)
+        {
+            for (int j = 0; j < N; ++j)
+            {
+                boxMin[j] = std::min(boxMin[j], mSamples[i][j]);
+                boxMax[j] = std::max(boxMax[j], mSamples[i][j]);
+            }
+        }
+    }
+    for (unsigned int node = mNumLeaves - 1; node > 0; --node)
+    {
+        for (int j = 0; j < N; ++j)
+        {
+            mBoxMin[node][j] = std::min(mBoxMin[2 * node][j], mBoxMin[2 * node + 1][j]);
+            mBoxMax[node][j] = std::max(mBoxMax[2 * node][j], mBoxMax[2 * node + 1][j]);
+        }
+    }
+}
+
+template <int N, typename Real>
+Real SplineHausdorff<N, Real>::BoxSquaredDistance(unsigned int node, Vector<N, Real> const& point) const
+{
+    Vector<N, Real> const& boxMin = mBoxMin[node];
+    Vector<N, Real> const& boxMax = mBoxMax[node];
+    Real sqrLength = (Real)0;
+    for (int j = 0; j < N; ++j)
+    {
+        Real d = (Real)0;
+        if (point[j] < boxMin[j]) d = boxMin[j] - point[j];
+        else if (point[j] > boxMax[j]) d = point[j] - boxMax[j];
+        sqrLength += d * d;
+    }
+    return sqrLength;
+}
+
+template <int N, typename Real>
+void SplineHausdorff<N, Real>::ScanRun(unsigned int run, Vector<N, Real> const& point, Real& best, unsigned int& bestIndex) const
+{
+    unsigned int end = std::min((run + 1) * RUN_SIZE, mNumSamples);
+    SPLINE_STATS(mNumDistances += end - run * RUN_SIZE);
+    for (unsigned int i = run * RUN_SIZE; i < end; ++i)
+    {
+        Vector<N, Real> diff = point - mSamples[i];
+        Real sqrLength = Dot(diff, diff);
+        if (sqrLength < best)
+        {
+            best = sqrLength;
+            bestIndex = i;
+            if (best == 0) return;
+        }
+    }
+}
+
+template <int N, typename Real>
+Real SplineHausdorff<N, Real>::SquaredDistance(Vector<N, Real> const& point, Real cap, unsigned int& hint) const
+{
+    Real best = cap;
+    if (mNumSamples == 0) return best;
+    if (hint >= mNumSamples) hint = 0;
+
+    // Warm start: the nearest spline sample of the previous query is usually
+    // within one run of the nearest one for this query.
+    unsigned int warmRun = hint / RUN_SIZE;
+    ScanRun(warmRun, point, best, hint);
+    if (best == 0) return best;
+
+    unsigned int stackSize = 0;
+    mStack[stackSize++] = 1;
+    while (stackSize > 0)
+    {
+        unsigned int node = mStack[--stackSize];
+        // The slack keeps the box bound conservative if the compiler contracts
+        // the point distance differently from the box distance.
+        if (BoxSquaredDistance(node, point) * (Real)0.9999 >= best) continue;
+
+        if (node >= mNumLeaves)
+        {
+            unsigned int run = node - mNumLeaves;
+            if (run == warmRun) continue;
+            ScanRun(run, point, best, hint);
+            if (best == 0) return best;
+        }
+        else
+        {
+            // Visit the nearer child first so the bound tightens quickly.
+            unsigned int nearChild = 2 * node, farChild = 2 * node + 1;
+            if (BoxSquaredDistance(farChild, point) < BoxSquaredDistance(nearChild, point))
+                std::swap(nearChild, farChild);
+            mStack[stackSize++] = farChild;
+            mStack[stackSize++] = nearChild;
+        }
+    }
+    return best;
+}
+
+template <int N, typename Real>
+Real SplineHausdorff<N, Real>::MaxSquaredDistance(Vector<N, Real> const* samples, unsigned int numSamples, Real cap,
+    Real const* sqrWeights, Real bound) const
+{
+    // The slack makes any distance capped at sqrBound compare >= bound after
+    // the square root, whatever the rounding.
+    Real sqrBound = bound * bound * (Real)1.0001;
+    // Unweighted queries need nothing beyond sqrBound, and a lower cap lets
+    // the tree search discard more boxes.
+    Real searchCap = sqrWeights ? cap : std::min(cap, sqrBound);
+    Real maxLength = (Real)0;
+    unsigned int hint = 0;
+    for (unsigned int i = 0; i < numSamples; ++i)
+    {
+        Real minLength = SquaredDistance(samples[i], searchCap, hint);
+        if (sqrWeights) minLength *= sqrWeights[i];
+        if (minLength > maxLength)
+        {
+            maxLength = minLength;
+            if (maxLength >= bound * bound && std::sqrt(maxLength) >= bound) return maxLength;
+        }
+    }
+    return maxLength;
+}
+
+template class SplineHausdorff<3, float>;
+template class SplineHausdorff<3, double>;
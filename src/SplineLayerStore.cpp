@@ -0,0 +1,66 @@
+#include "SplineLayerStore.h"
+#include <algorithm>
+
+SplineLayerStore::SplineLayerStore()
+    :
+    mNextKey(0)
+{
+}
+
+void SplineLayerStore::Put(unsigned int key, vector<vector<Vector3<float>>>&& blocks)
+{
+    size_t i = Find(key);
+    if (i == mLayers.size())
+    {
+        mLayers.push_back(Layer());
+        mLayers[i].key = key;
+        mNextKey = std::max(mNextKey, key + 1);
+    }
+    Layer& layer = mLayers[i];
+    layer.blocks = std::move(blocks);
+    layer.dirty = true;
+    layer.samples.clear();
+}
+
+unsigned int SplineLayerStore::Append(vector<vector<Vector3<float>>>&& blocks)
+{
+    unsigned int key = mNextKey;
+    Put(key, std::move(blocks));
+    return key;
+}
+
+bool SplineLayerStore::Remove(unsigned int key)
+{
+    size_t i = Find(key);
+    if (i == mLayers.size()) return false;
+    mLayers.erase(mLayers.begin() + i);
+    return true;
+}
+
+void SplineLayerStore::Clear()
+{
+    mLayers.clear();
+}
+
+void SplineLayerStore::ClearSamples()
+{
+    for (auto& layer : mLayers)
+    {
+        layer.dirty = true;
+        layer.samples.clear();
+    }
+}
+
+size_t SplineLayerStore::Find(unsigned int key) const
+{
+    for (size_t i = 0; i < mLayers.size(); ++i)
+        if (mLayers[i].key == key) return i;
+    return mLayers.size();
+}
+
+void SplineLayerStore::SetSamples(size_t i, vector<Vector3<float>>&& samples)
+{
+    Layer& layer = mLayers[i];
+    layer.samples = std::move(samples);
+    layer.dirty = false;
+}
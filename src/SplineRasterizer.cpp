@@ -0,0 +1,61 @@
+#include "SplineRasterizer.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Below this the step no longer changes the position in float.
+static const double MIN_STEP = 1e-9;
+
+SplineRasterizer::SplineRasterizer(SplineArena& arena)
+    :
+    mArena(arena),
+    mEvaluate(arena)
+{
+}
+
+void SplineRasterizer::Rasterize(vector<Vector3<float>> const& block, PixelSink const& sink)
+{
+    if (block.empty()) return;
+    int numControls = (int)block[0][0], degree = (int)block[0][1];
+    unsigned int numSamples = (unsigned int)block[0][2];
+    if (numControls < 1 || block.size() < (size_t)numControls + 1) return;
+    if (numControls == 1 || degree < 1)
+    {
+        Vector3<float> const& point = block[numControls];
+        sink((int)point[0], (int)point[1], (int)point[2]);
+        return;
+    }
+
+    SplineArena::Scope scope(mArena);
+    mEvaluate.SetControls(degree, numControls, reinterpret_cast<float const*>(&block[1]));
+
+    // Start from the sampling decoder's step and never grow beyond it: a
+    // long step whose endpoints share a pixel can pass over a hairpin.
+    double maxStep = 1.0 / std::max(numSamples * 1.1 - 1.0, 1.0);
+    double step = maxStep;
+    double t = 0.0;
+    float position[3];
+    mEvaluate.Evaluate(0.0, position);
+    int x = (int)position[0], y = (int)position[1];
+    sink(x, y, (int)position[2]);
+    while (t < 1.0)
+    {
+        double next = std::min(t + step, 1.0);
+        mEvaluate.Evaluate(next, position);
+        int nextX = (int)position[0], nextY = (int)position[1];
+        int jump = std::abs(nextX - x) + std::abs(nextY - y);
+        if (jump > 1 && step > MIN_STEP)
+        {
+            step *= 0.5;
+            continue;
+        }
+        t = next;
+        if (jump == 0)
+        {
+            step = std::min(step * 2.0, maxStep);
+            continue;
+        }
+        x = nextX;
+        y = nextY;
+        sink(x, y, (int)position[2]);
+    }
+}
@@ -0,0 +1,114 @@
+#include "SplineThreadPool.h"
+
+SplineThreadPool::SplineThreadPool(unsigned int numWorkers)
+    :
+    mNumWorkers(numWorkers),
+    mTask(nullptr),
+    mGeneration(0),
+    mBusy(0),
+    mStop(false)
+{
+    if (mNumWorkers == 0) mNumWorkers = thread::hardware_concurrency();
+    if (mNumWorkers == 0) mNumWorkers = 1;
+
+    for (unsigned int i = 0; i < mNumWorkers; ++i)
+        mQueues.push_back(std::make_unique<Queue>());
+    for (unsigned int i = 1; i < mNumWorkers; ++i)
+        mThreads.emplace_back(&SplineThreadPool::WorkerLoop, this, i);
+}
+
+SplineThreadPool::~SplineThreadPool()
+{
+    {
+        lock_guard<mutex> guard(mLock);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (auto& worker : mThreads) worker.join();
+}
+
+void SplineThreadPool::Run(vector<unsigned int> const& order, function<void(unsigned int, unsigned int)> const& task)
+{
+    if (order.empty()) return;
+    for (unsigned int i = 0; i < order.size(); ++i)
+        mQueues[i % mNumWorkers]->tasks.push_back(order[i]);
+
+    {
+        lock_guard<mutex> guard(mLock);
+        mTask = &task;
+        mError = nullptr;
+        mBusy = mNumWorkers;
+        ++mGeneration;
+    }
+    mWake.notify_all();
+
+    Drain(0);
+
+    unique_lock<mutex> guard(mLock);
+    mDone.wait(guard, [this] { return mBusy == 0; });
+    mTask = nullptr;
+    if (mError) rethrow_exception(mError);
+}
+
+void SplineThreadPool::WorkerLoop(unsigned int worker)
+{
+    unsigned int seen = 0;
+    while (1)
+    {
+        {
+            unique_lock<mutex> guard(mLock);
+            mWake.wait(guard, [&] { return mStop || mGeneration != seen; });
+            if (mStop) return;
+            seen = mGeneration;
+        }
+        Drain(worker);
+    }
+}
+
+void SplineThreadPool::Drain(unsigned int worker)
+{
+    unsigned int index;
+    while (Next(worker, index))
+    {
+        try
+        {
+            (*mTask)(index, worker);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> guard(mLock);
+            if (!mError) mError = current_exception();
+        }
+    }
+
+    lock_guard<mutex> guard(mLock);
+    if (--mBusy == 0) mDone.notify_all();
+}
+
+bool SplineThreadPool::Next(unsigned int worker, unsigned int& index)
+{
+    {
+        Queue& own = *mQueues[worker];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            index = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // Tasks are never added while a run is in progress, so one pass over the
+    // other queues finding nothing means the run has no work left.
+    for (unsigned int i = 1; i < mNumWorkers; ++i)
+    {
+        Queue& victim = *mQueues[(worker + i) % mNumWorkers];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            index = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,81 @@
+// Decoding with a BSplineCurveFitterWindow3 that never fitted anything must
+// give the samples the fitting instance reconstructs: control blocks are in
+// pixel units and decoding does not depend on the fitter's diagonal.
+//
+// Returns 0 on success and prints the failed check otherwise.
+
+#include "BSplineCurveFitterWindow3.h"
+#include <climits>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    int const Width = 512, Height = 512;
+    int numFailures = 0;
+
+    void Check(bool condition, char const* what)
+    {
+        if (condition) return;
+        printf("FAILED: %s\n", what);
+        numFailures++;
+    }
+
+    // A few pixel arcs, normalized by the image diagonal like the
+    // skeletonizer's branches, with a slowly varying radius.
+    vector<vector<Vector3<float>>> MakeBranches(float diagonal)
+    {
+        vector<vector<Vector3<float>>> branches;
+        for (int b = 0; b < 4; ++b)
+        {
+            vector<Vector3<float>> branch;
+            for (int i = 0; i < 120 + 40 * b; ++i)
+            {
+                float x = 40.0f + 1.5f * i;
+                float y = 100.0f + 90.0f * b + 30.0f * std::sin(i * 0.04f * (b + 1));
+                float radius = 3.0f + std::floor(i / 50.0f);
+                branch.push_back({std::floor(x) / diagonal, std::floor(y) / diagonal, radius / diagonal});
+            }
+            branches.push_back(branch);
+        }
+        return branches;
+    }
+
+    bool InImage(vector<Vector3<float>> const& samples)
+    {
+        for (auto const& sample : samples)
+            if (!(sample[0] >= 0 && sample[0] < Width && sample[1] >= 0 && sample[1] < Height)) return false;
+        return true;
+    }
+}
+
+int main()
+{
+    float diagonal = std::sqrt((float)(Width * Width + Height * Height));
+    BSplineCurveFitterWindow3 fitter;
+    fitter.indexingSpline(MakeBranches(diagonal), 0.003f, diagonal, 0, 0);
+    vector<vector<vector<Vector3<float>>>> const& index = fitter.get_indexingCP();
+    vector<vector<Vector3<float>>> expected = fitter.ReadIndexingSpline();
+    Check(!expected.empty() && !expected.back().empty(), "the fitter reconstructs samples");
+    for (auto const& layer : expected) Check(InImage(layer), "the fitter's samples lie in the image");
+
+    // From the nested blocks.
+    BSplineCurveFitterWindow3 decoder;
+    for (size_t layer = 0; layer < index.size(); ++layer)
+    {
+        vector<Vector3<float>> samples = decoder.ReadIndexingSpline(index[layer]);
+        Check(InImage(samples), "a new instance decodes blocks into the image");
+        Check(samples == expected[layer], "a new instance decodes blocks like the fitter");
+    }
+
+    // From a packed stream.
+    vector<unsigned char> bytes;
+    Check(EncodeSplineCP(index, diagonal, bytes), "the index encodes");
+    SplineCPReader reader;
+    Check(reader.Attach(bytes.data(), bytes.size()), "the stream attaches");
+    BSplineCurveFitterWindow3 streamDecoder;
+    Check(streamDecoder.ReadIndexingSpline(reader) == expected, "a new instance decodes a stream like the fitter");
+
+    if (numFailures == 0) printf("passed\n");
+    return numFailures == 0 ? 0 : 1;
+}